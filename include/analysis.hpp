@@ -0,0 +1,191 @@
+#pragma once
+
+#include <span>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include <stop_token>
+#include <condition_variable>
+#include "board.hpp"
+#include "search.hpp"
+#include "maxn.hpp"
+#include "parallel_search.hpp"
+
+//Scores for every legal move of a position, worked out on background threads for showing them while a game goes on
+namespace analysis {
+
+	struct MoveScore {
+		TriCoord move;
+		int score = 0; //for the player to move, higher is better
+		int depth = 0; //0 until the move has a score
+	};
+
+	//How good every scored move is next to the others, 0 for the worst up to 1 for the best.
+	//Decided scores count as just past the best and worst undecided ones, so they don't squash the rest together.
+	std::vector<std::pair<TriCoord, float>> heatMap(std::span<const MoveScore> scores) {
+		constexpr int decided = search::win_score / 2;
+		int low = std::numeric_limits<int>::max(), high = std::numeric_limits<int>::min();
+		for (auto& s : scores) {
+			if (s.depth == 0 || std::abs(s.score) > decided) continue;
+			low = std::min(low, s.score);
+			high = std::max(high, s.score);
+		}
+		if (low > high) low = high = 0;
+		std::vector<std::pair<TriCoord, float>> heat;
+		for (auto& s : scores) {
+			if (s.depth == 0) continue;
+			const int score = std::clamp(s.score, low - 1, high + 1);
+			heat.emplace_back(s.move, static_cast<float>(score - (low - 1)) / static_cast<float>(high - low + 2));
+		}
+		return heat;
+	}
+
+	//Scores the moves of the latest position given to analyze() one depth at a time, so every move gets a rough score
+	//quickly and they all get better together. A new position cancels the searches of the old one through their stop
+	//tokens. Two player positions get an alpha-beta search after each move, more players a max-n search of the replies.
+	//
+	//Nothing a caller does waits for a search: the searches run without holding the lock, and poll() only tries to take it.
+	class MoveAnalyzer {
+	public:
+		struct Settings {
+			int threads = 1;
+			int max_depth = 8;
+			int max_depth_multiplayer = 2; //max-n has no table and prunes little, so its searches are kept short
+			std::size_t table_bytes = std::size_t(4) << 20; //for every thread
+		};
+
+	private:
+		struct Job {
+			Board board;
+			int player;
+			int num_players;
+			int max_depth;
+			std::vector<TriCoord> moves{};
+			std::stop_token stop{};
+		};
+
+		Settings _settings;
+		std::mutex _mutex; //for everything below
+		std::condition_variable _wake;
+		std::shared_ptr<const Job> _job;
+		std::stop_source _stop;
+		std::size_t _next = 0; //work item depth * moves + move of the job
+		std::vector<MoveScore> _scores;
+		std::uint64_t _version = 0, _polled = 0;
+		bool _quit = false;
+		std::vector<std::jthread> _threads;
+
+		static std::size_t items(const Job& job) {
+			return job.moves.size() * job.max_depth;
+		}
+
+		//Score of the job's move i searched depth moves deep counting itself, nothing if the search was stopped
+		static std::optional<int> scoreMove(search::ParallelSearch& searcher, const Job& job, std::size_t i, int depth) {
+			Board child = job.board;
+			switch (playMove(child, job.moves[i], job.player)) {
+			case MoveEnd::Won:
+				return search::win_score - 1;
+			case MoveEnd::Endless:
+				return 0;
+			default:
+				break;
+			}
+			const int next = nextActivePlayer(child, job.player, job.num_players);
+			if (job.num_players > 2) {
+				if (depth == 1) return search::evaluateShares(child, job.num_players)[job.player];
+				const int share = search::detail::maxN(child, next, job.num_players, depth - 1, search::maxn_total, job.stop)[job.player];
+				if (job.stop.stop_requested()) return {};
+				return share;
+			}
+			if (depth == 1) return -search::evaluate(child, next);
+			searcher.setLimits(depth - 1, std::chrono::milliseconds(0), 0);
+			auto result = searcher.search(child, next, job.stop);
+			if (job.stop.stop_requested() || !result.move) return {};
+			return -result.score;
+		}
+
+		void work() {
+			search::ParallelSearch searcher({ .threads = 1, .max_depth = _settings.max_depth, .time_limit = std::chrono::milliseconds(0), .table_bytes = _settings.table_bytes });
+			std::unique_lock lock(_mutex);
+			while (true) {
+				_wake.wait(lock, [&] {return _quit || (_job && _next < items(*_job)); });
+				if (_quit) return;
+				auto job = _job;
+				const std::size_t item = _next++;
+				lock.unlock();
+				const int depth = static_cast<int>(item / job->moves.size()) + 1;
+				const std::size_t i = item % job->moves.size();
+				const auto score = scoreMove(searcher, *job, i, depth);
+				lock.lock();
+				if (score && job == _job && depth > _scores[i].depth) {
+					_scores[i].score = *score;
+					_scores[i].depth = depth;
+					++_version;
+				}
+			}
+		}
+
+	public:
+		explicit MoveAnalyzer(const Settings& settings) : _settings(settings) {
+			for (int t = 0; t < std::max(settings.threads, 1); ++t) _threads.emplace_back([this] { work(); });
+		}
+
+		MoveAnalyzer(const MoveAnalyzer&) = delete;
+
+		~MoveAnalyzer() {
+			{
+				std::scoped_lock lock(_mutex);
+				_quit = true;
+				_stop.request_stop();
+			}
+			_wake.notify_all();
+			_threads.clear();
+		}
+
+		//Starts on a position between turns, dropping the last one
+		void analyze(const Board& b, int player, int num_players) {
+			auto job = std::make_shared<Job>(Job{
+				.board = b,
+				.player = player,
+				.num_players = num_players,
+				.max_depth = num_players > 2 ? _settings.max_depth_multiplayer : _settings.max_depth,
+			});
+			search::legalMoves(b, player, job->moves);
+			{
+				std::scoped_lock lock(_mutex);
+				_stop.request_stop();
+				_stop = {};
+				job->stop = _stop.get_token();
+				_job = job;
+				_next = 0;
+				_scores.assign(job->moves.size(), {});
+				for (std::size_t i = 0; i < job->moves.size(); ++i) _scores[i].move = job->moves[i];
+				++_version;
+			}
+			_wake.notify_all();
+		}
+
+		//Stops working on the position, without starting on another one
+		void cancel() {
+			std::scoped_lock lock(_mutex);
+			_stop.request_stop();
+			_job.reset();
+			_scores.clear();
+			++_version;
+		}
+
+		//The scores if they changed since the last poll, nothing if they didn't or a thread is just writing them
+		std::optional<std::vector<MoveScore>> poll() {
+			std::unique_lock lock(_mutex, std::try_to_lock);
+			if (!lock || _version == _polled) return {};
+			_polled = _version;
+			return _scores;
+		}
+	};
+}
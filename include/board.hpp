@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <span>
 #include <optional>
+#include <cstdint>
 #include "coords.hpp"
 
 struct TileState {
@@ -12,14 +13,27 @@ struct TileState {
 	int num = 0;
 };
 
+//A tile in one byte as (player + 1) * 16 + pieces, for keeping lots of boards around.
+//Only for tiles between turns, with no more than 15 pieces and fewer than 15 players.
+std::uint8_t packTile(TileState t) {
+	return static_cast<std::uint8_t>((t.player + 1) * 16 + t.num);
+}
+
+TileState unpackTile(std::uint8_t packed) {
+	return { (packed >> 4) - 1, packed & 15 };
+}
+
 class Board {
 	std::vector<TileState> _state;
 	std::vector<TriCoord> _exploding;
+	std::vector<TriCoord> _processing; //scratch for update_step, kept to reuse its capacity
 	std::vector<int> _totals;
+	std::vector<TriCoord> _changed; //only filled while tracking changes
+	bool _track_changes = false;
 	int _size;
 
 	TileState& get(TriCoord c) {
-		return _state[c.x * 2 + c.y * _size * 4 + c.R];
+		return _state[index(c)];
 	}
 
 public:
@@ -38,6 +52,11 @@ public:
 		return {};
 	}
 
+	//Players who already had a turn and lost all their pieces since, they can't move anymore
+	bool isEliminated(int player) const {
+		return std::size_t(player) < _totals.size() && _totals[player] == 0;
+	}
+
 	bool inBounds(TriCoord c) const {
 		auto b = c.bary(_size);
 		auto [min, max] = std::minmax({ b.x,b.y,b.z });
@@ -63,8 +82,33 @@ public:
 		return _size;
 	}
 
+	//Position of a tile in tiles(), out of bounds coordinates within [0,size*2) still get a (never used) slot
+	std::size_t index(TriCoord c) const {
+		return c.x * 2 + c.y * _size * 4 + c.R;
+	}
+
+	TriCoord coord(std::size_t index) const {
+		return { static_cast<int>(index % (_size * 4)) / 2, static_cast<int>(index / (_size * 4)), static_cast<bool>(index % 2) };
+	}
+
+	std::span<const TileState> tiles() const {
+		return _state;
+	}
+
+	//Restores a settled position from tiles() of a board of the same size, for code keeping boards in a compact format of its own.
+	//players is playerTotals().size() of that board, so players who moved and lost everything stay eliminated.
+	void load(std::span<const TileState> tiles, int players) {
+		std::ranges::copy(tiles, _state.begin());
+		_totals.assign(players, 0);
+		for (auto& s : _state) {
+			if (s.player >= 0) _totals[s.player] += s.num;
+		}
+		_exploding.clear();
+		_changed.clear();
+	}
+
 	TileState operator[](TriCoord c) const {
-		return _state[c.x * 2 + c.y * _size * 4 + c.R];
+		return _state[index(c)];
 	}
 
 	TileState at(TriCoord c) const {
@@ -90,15 +134,31 @@ public:
 		}
 		s.player = player;
 		s.num++;
+		if (_track_changes) _changed.push_back(c);
 		if (s.num > allowedPieces(c)) _exploding.push_back(c);
 		return true;
 	}
 
+	//Record every tile touched by moves and explosions from now on, so evaluators can look at just those
+	void trackChanges() {
+		_track_changes = true;
+		_changed.clear();
+	}
+
+	bool tracksChanges() const {
+		return _track_changes;
+	}
+
+	//Can contain duplicates
+	std::span<const TriCoord> changedTiles() const {
+		return _changed;
+	}
+
 	void update_step() {
-		std::vector<TriCoord> old_exploding;
-		std::swap(old_exploding, _exploding);
+		std::swap(_processing, _exploding);
+		_exploding.clear();
 
-		for (auto& c : old_exploding) {
+		for (auto& c : _processing) {
 			TileState& s = get(c);
 			if (s.num <= allowedPieces(c)) continue;
 			for (auto& n : c.neighbors()) {
@@ -106,6 +166,7 @@ public:
 			}
 			if (s.num == 0) s.player = -1;
 		}
+		_processing.clear(); //keeps copies of the board from dragging the scratch contents along
 	}
 
 	template<typename F>
@@ -119,4 +180,30 @@ public:
 			}
 		}
 	}
-};
\ No newline at end of file
+};
+
+enum class MoveEnd {
+	Continues,
+	Won, //by the player who moved, explosions can't take pieces away from them
+	Endless
+};
+
+//Plays a move including all its explosions, for searches that need to know how it ended
+MoveEnd playMove(Board& b, TriCoord c, int player) {
+	b.incTile(c, player);
+	const int max_steps = static_cast<int>(b.tiles().size()) * 16;
+	for (int step = 0; b.needsUpdate(); ++step) {
+		if (b.isWon()) return MoveEnd::Won;
+		if (step == max_steps) return MoveEnd::Endless;
+		b.update_step();
+	}
+	return b.isWon() ? MoveEnd::Won : MoveEnd::Continues;
+}
+//The next player after player out of num_players who is still in the game
+int nextActivePlayer(const Board& b, int player, int num_players) {
+	for (int i = 1; i < num_players; ++i) {
+		const int next = (player + i) % num_players;
+		if (!b.isEliminated(next)) return next;
+	}
+	return player;
+}
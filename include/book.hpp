@@ -0,0 +1,188 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include "board.hpp"
+#include "symmetry.hpp"
+#include "mapped_file.hpp"
+#include "search.hpp"
+
+//Precomputed opening moves for two player games.
+//
+//build() plays out the first plies from the empty board for both colors: every position where the book's side is to move
+//gets a deep search and only its best move is followed, every position of the other side is followed with all its moves.
+//Searches of a ply are spread over threads.
+//
+//Positions are stored under BoardSymmetries::canonicalHash, their move as a tile of the canonical position, so
+//symmetric positions share an entry. The file holds the entries sorted by hash behind an index of where every
+//value of the top index_bits bits starts, and is mapped into memory so opening it costs nothing.
+class OpeningBook {
+	struct Header {
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t board_size;
+		std::uint32_t index_bits;
+		std::uint64_t entries;
+	};
+
+	struct Entry {
+		std::uint64_t hash;
+		std::uint32_t tile; //of the canonical position
+		std::int32_t score; //search::negamax score of the move
+	};
+
+	static constexpr std::array<char, 4> file_magic = { 'E','T','O','B' };
+	static constexpr std::uint32_t file_version = 1;
+
+	MappedFile _file;
+	BoardSymmetries _symmetries;
+	int _index_bits = 0;
+	const std::uint32_t* _index = nullptr;
+	const Entry* _entries = nullptr;
+
+	OpeningBook(MappedFile file, const Header& header) : _file(std::move(file)), _symmetries(static_cast<int>(header.board_size)), _index_bits(static_cast<int>(header.index_bits)) {
+		_index = reinterpret_cast<const std::uint32_t*>(_file.data() + sizeof(Header));
+		_entries = reinterpret_cast<const Entry*>(_file.data() + sizeof(Header) + indexSize(_index_bits));
+	}
+
+	static std::size_t indexSize(int index_bits) {
+		//rounded up to keep the entries 8 byte aligned
+		return ((std::size_t(1) << index_bits) + 2) / 2 * 2 * sizeof(std::uint32_t);
+	}
+
+	static std::uint64_t bucket(std::uint64_t hash, int index_bits) {
+		return index_bits == 0 ? 0 : hash >> (64 - index_bits);
+	}
+
+public:
+	struct Settings {
+		int plies = 4; //how many moves from the start the book covers
+		int depth = 3; //of the searches
+		int threads = 1;
+	};
+
+	static std::optional<OpeningBook> open(const std::string& path) {
+		auto file = MappedFile::openReadOnly(path);
+		if (!file || file->size() < sizeof(Header)) return {};
+		Header header;
+		std::memcpy(&header, file->data(), sizeof(header));
+		if (std::memcmp(header.magic, file_magic.data(), file_magic.size()) != 0 || header.version != file_version || header.index_bits > 24) return {};
+		if (file->size() != sizeof(Header) + indexSize(static_cast<int>(header.index_bits)) + header.entries * sizeof(Entry)) return {};
+		return OpeningBook(std::move(*file), header);
+	}
+
+	int boardSize() const {
+		return _symmetries.size();
+	}
+
+	//Book move for the player to move, nothing for positions that aren't in the book
+	std::optional<TriCoord> probe(const Board& b, int player) const {
+		if (b.size() != boardSize() || b.playerTotals().size() > 2) return {};
+		const auto canonical = _symmetries.canonicalHash(b, player);
+		const auto h = bucket(canonical.hash, _index_bits);
+		const Entry* first = _entries + _index[h];
+		const Entry* last = _entries + _index[h + 1];
+		const Entry* e = std::lower_bound(first, last, canonical.hash, [](const Entry& e, std::uint64_t hash) {return e.hash < hash; });
+		if (e == last || e->hash != canonical.hash) return {};
+		return _symmetries.tile(_symmetries.image(canonical.symmetry, static_cast<int>(e->tile)));
+	}
+
+	//on_ply(ply, positions searched in it) is called after every ply
+	static bool build(int size, const std::string& path, const Settings& settings, auto on_ply) {
+		const BoardSymmetries sym(size);
+		std::unordered_map<std::uint64_t, Entry> book;
+
+		for (int book_side = 0; book_side < 2; ++book_side) {
+			std::vector<Board> positions = { Board(size) };
+			for (int ply = 0; ply < settings.plies && !positions.empty(); ++ply) {
+				const int player = ply % 2;
+				std::vector<Board> next;
+				std::unordered_set<std::uint64_t> seen;
+				auto add = [&](const Board& b) {
+					if (seen.insert(sym.canonicalHash(b, 1 - player).hash).second) next.push_back(b);
+				};
+
+				if (player != book_side) {
+					std::vector<TriCoord> moves;
+					for (auto& b : positions) {
+						search::legalMoves(b, player, moves);
+						for (auto c : moves) {
+							Board child = b;
+							if (playMove(child, c, player) == MoveEnd::Continues) add(child);
+						}
+					}
+				}
+				else {
+					//positions already in the book from the other pass don't need a search
+					std::vector<std::size_t> todo;
+					for (std::size_t i = 0; i < positions.size(); ++i) {
+						if (!book.contains(sym.canonicalHash(positions[i], player).hash)) todo.push_back(i);
+					}
+
+					std::atomic<std::size_t> next_search = 0;
+					std::mutex book_mutex;
+					auto worker = [&]() {
+						for (std::size_t i = next_search++; i < todo.size(); i = next_search++) {
+							const Board& b = positions[todo[i]];
+							auto result = search::negamax(b, player, settings.depth);
+							if (!result.move) continue;
+							const auto canonical = sym.canonicalHash(b, player);
+							const int tile = sym.preimage(canonical.symmetry, sym.tileNumber(*result.move));
+							std::scoped_lock lock(book_mutex);
+							book[canonical.hash] = { canonical.hash, static_cast<std::uint32_t>(tile), result.score };
+						}
+					};
+					{
+						std::vector<std::jthread> threads;
+						for (int t = 1; t < settings.threads; ++t) threads.emplace_back(worker);
+						worker();
+					}
+					on_ply(ply, todo.size());
+
+					for (auto& b : positions) {
+						auto canonical = sym.canonicalHash(b, player);
+						auto entry = book.find(canonical.hash);
+						if (entry == book.end()) continue;
+						Board child = b;
+						if (playMove(child, sym.tile(sym.image(canonical.symmetry, static_cast<int>(entry->second.tile))), player) == MoveEnd::Continues) add(child);
+					}
+				}
+				positions = std::move(next);
+			}
+		}
+
+		std::vector<Entry> entries;
+		for (auto& [hash, e] : book) entries.push_back(e);
+		std::ranges::sort(entries, {}, &Entry::hash);
+		int index_bits = 0;
+		while (index_bits < 24 && (std::size_t(1) << index_bits) < entries.size()) ++index_bits;
+
+		auto file = MappedFile::openWritable(path, sizeof(Header) + indexSize(index_bits) + entries.size() * sizeof(Entry));
+		if (!file) return false;
+		Header header{};
+		std::memcpy(header.magic, file_magic.data(), file_magic.size());
+		header.version = file_version;
+		header.board_size = static_cast<std::uint32_t>(size);
+		header.index_bits = static_cast<std::uint32_t>(index_bits);
+		header.entries = entries.size();
+		std::memcpy(file->data(), &header, sizeof(header));
+
+		auto* index = reinterpret_cast<std::uint32_t*>(file->data() + sizeof(Header));
+		std::size_t e = 0;
+		for (std::uint64_t h = 0; h <= (std::uint64_t(1) << index_bits); ++h) {
+			while (e < entries.size() && bucket(entries[e].hash, index_bits) < h) ++e;
+			index[h] = static_cast<std::uint32_t>(e);
+		}
+		std::memcpy(file->data() + sizeof(Header) + indexSize(index_bits), entries.data(), entries.size() * sizeof(Entry));
+		return true;
+	}
+};
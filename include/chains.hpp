@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include "board.hpp"
+#include "weights.hpp"
+
+//Scores a board by its chains: groups of adjacent tiles that are one piece away from exploding.
+//A chain containing an enemy tile is threatened and loses its pieces next turn, a safe chain is worth
+//its own pieces plus the enemy pieces next to it that it could take over.
+//
+//rebase() analyses a position once, after which evaluate() scores boards derived from it by only
+//redoing the chains around the tiles that changed. All buffers are kept between calls.
+class ChainEvaluator {
+	struct Chain {
+		int owned = 0; //how many of our own pieces are in this chain
+		bool threatened = false; //is this chain threatened by an enemy explosion next turn?
+		int threatened_by = 0; //Number of enemy pieces threatened by this chain
+
+		int score(const HeuristicWeights& w) const {
+			return threatened ? owned * w.chain_threatened : owned * w.chain_safe + threatened_by * w.chain_capture;
+		}
+	};
+
+	int _size = -1;
+	int _player = -1;
+	HeuristicWeights _weights;
+
+	//board geometry, indexed like Board::tiles()
+	std::vector<std::array<int, 3>> _neighbors; //-1 for out of bounds neighbors
+	std::vector<int> _allowed; //0 for out of bounds slots
+
+	//analysis of the base position
+	std::vector<TileState> _base;
+	std::vector<int> _chain_of; //first tile of the chain this tile is in, -1 if not part of a chain
+	std::vector<int> _chain_tiles; //start of the list of a chain's tiles, indexed by its first tile
+	std::vector<int> _next_in_chain; //links the tiles of a chain together, -1 ends the list
+	std::vector<int> _chain_score; //score of a chain, indexed by its first tile
+	std::vector<int> _loose; //score of pieces that aren't part of or next to a chain
+	int _base_score = 0;
+
+	//scratch
+	std::uint32_t _epoch = 0;
+	std::vector<std::uint32_t> _visited, _in_region, _removed;
+	std::vector<int> _stack, _region, _removed_chains;
+
+	void setGeometry(const Board& b) {
+		_size = b.size();
+		const std::size_t slots = b.tiles().size();
+		_neighbors.assign(slots, { -1,-1,-1 });
+		_allowed.assign(slots, 0);
+		b.iterTiles([&](TriCoord c) {
+			auto i = b.index(c);
+			_allowed[i] = b.allowedPieces(c);
+			auto n = c.neighbors();
+			for (int j = 0; j < 3; ++j) {
+				if (b.inBounds(n[j])) _neighbors[i][j] = static_cast<int>(b.index(n[j]));
+			}
+			return true;
+		});
+		_chain_of.assign(slots, -1);
+		_chain_tiles.assign(slots, -1);
+		_next_in_chain.assign(slots, -1);
+		_chain_score.assign(slots, 0);
+		_loose.assign(slots, 0);
+		_visited.assign(slots, 0);
+		_in_region.assign(slots, 0);
+		_removed.assign(slots, 0);
+		_epoch = 0;
+	}
+
+	bool critical(std::span<const TileState> tiles, int i) const {
+		return _allowed[i] != 0 && tiles[i].num == _allowed[i];
+	}
+
+	int looseScore(std::span<const TileState> tiles, int i) const {
+		if (tiles[i].player != _player || critical(tiles, i)) return 0;
+		for (int n : _neighbors[i]) {
+			if (n >= 0 && critical(tiles, n)) return 0;
+		}
+		return tiles[i].num * _weights.loose_piece;
+	}
+
+	//Walks the whole chain containing start, calling on_tile for each of its tiles
+	Chain fillChain(std::span<const TileState> tiles, int start, auto on_tile) {
+		Chain chain;
+		_stack.clear();
+		_stack.push_back(start);
+		_visited[start] = _epoch;
+		while (!_stack.empty()) {
+			int i = _stack.back();
+			_stack.pop_back();
+			on_tile(i);
+			if (tiles[i].player == _player) chain.owned += tiles[i].num;
+			else chain.threatened = true;
+
+			for (int n : _neighbors[i]) {
+				if (n < 0) continue;
+				if (critical(tiles, n)) {
+					if (_visited[n] != _epoch) {
+						_visited[n] = _epoch;
+						_stack.push_back(n);
+					}
+				}
+				else if (tiles[n].num > 0 && tiles[n].player != _player) {
+					chain.threatened_by += tiles[n].num;
+				}
+			}
+		}
+		return chain;
+	}
+
+	void addToRegion(int i) {
+		if (_in_region[i] == _epoch) return;
+		_in_region[i] = _epoch;
+		_region.push_back(i);
+	}
+
+public:
+	//Takes effect with the next rebase()
+	void setWeights(const HeuristicWeights& weights) {
+		_weights = weights;
+	}
+
+	//Full analysis of b, reusing the memory of the previous one when the board size matches
+	void rebase(const Board& b, int player) {
+		if (b.size() != _size) setGeometry(b);
+		_player = player;
+		_base.assign(b.tiles().begin(), b.tiles().end());
+		++_epoch;
+
+		_base_score = 0;
+		for (int i = 0; i < static_cast<int>(_base.size()); ++i) {
+			_loose[i] = looseScore(_base, i);
+			_base_score += _loose[i];
+			_chain_of[i] = -1;
+		}
+
+		for (int i = 0; i < static_cast<int>(_base.size()); ++i) {
+			if (!critical(_base, i) || _visited[i] == _epoch) continue;
+			int last = -1;
+			auto chain = fillChain(_base, i, [&](int t) {
+				_chain_of[t] = i;
+				_next_in_chain[t] = last;
+				last = t;
+			});
+			_chain_tiles[i] = last;
+			_chain_score[i] = chain.score(_weights);
+			_base_score += _chain_score[i];
+		}
+	}
+
+	int score() const {
+		return _base_score;
+	}
+
+	//Scores a board reached from the rebased one. Only the tiles that differ from it and their neighbors are
+	//looked at, taken from moved.changedTiles() if the board tracked them and found by comparing otherwise.
+	int evaluate(const Board& moved) {
+		auto tiles = moved.tiles();
+		++_epoch;
+		_region.clear();
+		_removed_chains.clear();
+
+		auto addChanged = [&](int i) {
+			addToRegion(i);
+			for (int n : _neighbors[i]) {
+				if (n >= 0) addToRegion(n);
+			}
+		};
+		if (moved.tracksChanges()) {
+			for (auto c : moved.changedTiles()) addChanged(static_cast<int>(moved.index(c)));
+		}
+		else {
+			for (int i = 0; i < static_cast<int>(tiles.size()); ++i) {
+				if (tiles[i].num != _base[i].num || tiles[i].player != _base[i].player) addChanged(i);
+			}
+		}
+
+		int count = _base_score;
+
+		//take out everything the changes could have influenced
+		for (int i : _region) {
+			count -= _loose[i];
+			int chain = _chain_of[i];
+			if (chain >= 0 && _removed[chain] != _epoch) {
+				_removed[chain] = _epoch;
+				_removed_chains.push_back(chain);
+				count -= _chain_score[chain];
+			}
+		}
+
+		//and put it back as it is on the new board
+		for (int i : _region) {
+			count += looseScore(tiles, i);
+		}
+		auto rescore = [&](int i) {
+			if (critical(tiles, i) && _visited[i] != _epoch) {
+				count += fillChain(tiles, i, [](int) {}).score(_weights);
+			}
+		};
+		for (int i : _region) {
+			rescore(i);
+		}
+		for (int chain : _removed_chains) {
+			for (int i = _chain_tiles[chain]; i >= 0; i = _next_in_chain[i]) rescore(i);
+		}
+
+		return count;
+	}
+};
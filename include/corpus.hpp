@@ -0,0 +1,364 @@
+#pragma once
+
+#include <array>
+#include <queue>
+#include <vector>
+#include <string>
+#include <span>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
+#include "board.hpp"
+#include "symmetry.hpp"
+#include "mapped_file.hpp"
+#include "game_record.hpp"
+
+//Unique positions out of game records, for tuning and learning.
+//
+//Every position a player had to move from goes in once for all 12 symmetric versions, from the point of view of the
+//player to move. A position is its canonical hash, how often it came up, how often the player to move went on to win
+//from it, and a byte per tile in the canonical orientation, coded like BoardSymmetries::tileCode: 0 empty,
+//1..allowed own pieces, allowed+1..2*allowed someone else's. Positions are stored at a fixed stride sorted by hash
+//behind a header of one cache line, so a mapped corpus is read by plain indexing.
+//
+//Builder finds the duplicates with an external merge sort: positions collect in a buffer of a fixed size, full buffers are
+//sorted, merged down to one entry per position and written to a run file, and the runs are merged into the corpus at the end.
+//Memory stays within Settings::memory_bytes however many games go in.
+namespace corpus {
+
+	constexpr std::array<char, 4> file_magic = { 'E','T','P','C' };
+	constexpr std::uint32_t file_version = 1;
+	constexpr std::size_t tiles_offset = 16; //hash, seen and wins come first
+
+	struct alignas(64) Header {
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t board_size;
+		std::uint32_t stride;
+		std::uint64_t positions;
+	};
+
+	struct PositionView {
+		std::uint64_t hash;
+		std::uint32_t seen; //games the position came up in
+		std::uint32_t wins; //of those, games won by the player to move
+		std::span<const std::uint8_t> tiles;
+	};
+
+	std::size_t strideFor(std::size_t tiles) {
+		return (tiles_offset + tiles + 7) / 8 * 8;
+	}
+
+	namespace detail {
+		std::uint64_t hashOf(const std::uint8_t* p) {
+			std::uint64_t h;
+			std::memcpy(&h, p, sizeof(h));
+			return h;
+		}
+
+		//by hash, ties by the tiles so positions with the same hash are still told apart
+		int compare(const std::uint8_t* a, const std::uint8_t* b, std::size_t stride) {
+			const auto ha = hashOf(a), hb = hashOf(b);
+			if (ha != hb) return ha < hb ? -1 : 1;
+			return std::memcmp(a + tiles_offset, b + tiles_offset, stride - tiles_offset);
+		}
+
+		//adds seen and wins of from to into
+		void addCounts(std::uint8_t* into, const std::uint8_t* from) {
+			std::array<std::uint32_t, 2> a, b;
+			std::memcpy(a.data(), into + 8, sizeof(a));
+			std::memcpy(b.data(), from + 8, sizeof(b));
+			a[0] += b[0];
+			a[1] += b[1];
+			std::memcpy(into + 8, a.data(), sizeof(a));
+		}
+
+		//Writes sorted positions, adding up the counts of runs of the same one
+		class MergingWriter {
+			std::ofstream& _out;
+			std::size_t _stride;
+			std::vector<std::uint8_t> _pending;
+			bool _has_pending = false;
+			std::uint64_t _written = 0;
+
+		public:
+			MergingWriter(std::ofstream& out, std::size_t stride) : _out(out), _stride(stride), _pending(stride) {}
+
+			void add(const std::uint8_t* p) {
+				if (_has_pending && compare(_pending.data(), p, _stride) == 0) {
+					addCounts(_pending.data(), p);
+					return;
+				}
+				flush();
+				std::memcpy(_pending.data(), p, _stride);
+				_has_pending = true;
+			}
+
+			void flush() {
+				if (!_has_pending) return;
+				_out.write(reinterpret_cast<const char*>(_pending.data()), static_cast<std::streamsize>(_stride));
+				_has_pending = false;
+				++_written;
+			}
+
+			std::uint64_t written() const { return _written; }
+		};
+
+		//Reads a run file a buffer at a time
+		class RunReader {
+			std::ifstream _in;
+			std::size_t _stride;
+			std::vector<std::uint8_t> _buffer;
+			std::size_t _pos = 0, _len = 0;
+
+		public:
+			RunReader(const std::string& path, std::size_t stride, std::size_t buffer_bytes)
+				: _in(path, std::ios::binary), _stride(stride), _buffer(std::max(buffer_bytes / stride, std::size_t(1)) * stride) {
+				fill();
+			}
+
+			void fill() {
+				_in.read(reinterpret_cast<char*>(_buffer.data()), static_cast<std::streamsize>(_buffer.size()));
+				_len = static_cast<std::size_t>(_in.gcount()) / _stride * _stride;
+				_pos = 0;
+			}
+
+			bool done() const { return _pos == _len; }
+
+			const std::uint8_t* current() const { return &_buffer[_pos]; }
+
+			void next() {
+				_pos += _stride;
+				if (_pos == _len) fill();
+			}
+		};
+
+		//k-way merge of sorted runs into out
+		std::uint64_t mergeRuns(std::span<const std::string> runs, std::ofstream& out, std::size_t stride, std::size_t memory_bytes) {
+			std::vector<RunReader> readers;
+			readers.reserve(runs.size());
+			for (auto& run : runs) readers.emplace_back(run, stride, memory_bytes / (runs.size() + 1));
+
+			auto later = [&](std::size_t a, std::size_t b) {
+				return compare(readers[a].current(), readers[b].current(), stride) > 0;
+			};
+			std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heap(later);
+			for (std::size_t i = 0; i < readers.size(); ++i) {
+				if (!readers[i].done()) heap.push(i);
+			}
+			MergingWriter writer(out, stride);
+			while (!heap.empty()) {
+				const auto i = heap.top();
+				heap.pop();
+				writer.add(readers[i].current());
+				readers[i].next();
+				if (!readers[i].done()) heap.push(i);
+			}
+			writer.flush();
+			return writer.written();
+		}
+	}
+
+	//A corpus file mapped read only
+	class PositionCorpus {
+		MappedFile _file;
+		Header _header;
+		const std::uint8_t* _positions;
+		BoardSymmetries _symmetries;
+
+		PositionCorpus(MappedFile file, const Header& header)
+			: _file(std::move(file)), _header(header), _positions(reinterpret_cast<const std::uint8_t*>(_file.data()) + sizeof(Header)), _symmetries(static_cast<int>(header.board_size)) {}
+
+	public:
+		static std::optional<PositionCorpus> open(const std::string& path) {
+			auto file = MappedFile::openReadOnly(path);
+			if (!file || file->size() < sizeof(Header)) return {};
+			Header header;
+			std::memcpy(&header, file->data(), sizeof(header));
+			if (std::memcmp(header.magic, file_magic.data(), file_magic.size()) != 0 || header.version != file_version || header.board_size == 0) return {};
+			if (header.stride != strideFor(BoardSymmetries(static_cast<int>(header.board_size)).numTiles())) return {};
+			if (file->size() != sizeof(Header) + header.positions * header.stride) return {};
+			return PositionCorpus(std::move(*file), header);
+		}
+
+		int boardSize() const { return static_cast<int>(_header.board_size); }
+		std::size_t size() const { return static_cast<std::size_t>(_header.positions); }
+		std::size_t stride() const { return _header.stride; }
+
+		//Tile t is BoardSymmetries::tile(t) of the board size
+		const BoardSymmetries& symmetries() const { return _symmetries; }
+
+		PositionView operator[](std::size_t i) const {
+			const std::uint8_t* p = _positions + i * _header.stride;
+			std::array<std::uint32_t, 2> counts;
+			std::memcpy(counts.data(), p + 8, sizeof(counts));
+			return { detail::hashOf(p), counts[0], counts[1], { p + tiles_offset, _symmetries.numTiles() } };
+		}
+
+		//Position i on b with player 0 to move, the others' pieces all go to player 1
+		void load(std::size_t i, Board& b) const {
+			thread_local std::vector<TileState> tiles;
+			tiles.assign(b.tiles().size(), TileState{});
+			auto codes = (*this)[i].tiles;
+			int players = 0;
+			for (std::size_t t = 0; t < codes.size(); ++t) {
+				if (codes[t] == 0) continue;
+				const int allowed = _symmetries.allowed(static_cast<int>(t));
+				const int player = codes[t] > allowed;
+				tiles[b.index(_symmetries.tile(static_cast<int>(t)))] = { player, codes[t] - player * allowed };
+				players = std::max(players, player + 1);
+			}
+			b.load(tiles, players);
+		}
+	};
+
+	struct Settings {
+		int board_size = 0; //0 takes the size of the first game, games on other sizes are skipped
+		std::size_t memory_bytes = std::size_t(256) << 20;
+		std::size_t merge_fan_in = 64; //runs merged at once, at least 2, more runs get merged in several passes
+	};
+
+	struct Report {
+		long long games = 0;
+		long long skipped_games = 0; //on other board sizes
+		long long positions = 0;
+		std::uint64_t unique = 0;
+		std::size_t runs = 0;
+		double seconds = 0;
+	};
+
+	//Builds a corpus at path. Run files go next to it and are gone again once finish() is done.
+	class Builder {
+		std::string _path;
+		Settings _settings;
+		std::optional<BoardSymmetries> _symmetries;
+		std::size_t _stride = 0;
+		std::vector<std::uint8_t> _buffer;
+		std::size_t _buffered = 0, _capacity = 0;
+		std::vector<std::uint32_t> _order;
+		std::vector<std::string> _runs;
+		std::size_t _run_names = 0;
+		bool _failed = false; //a run couldn't be written, the corpus would miss positions
+		Report _report;
+		std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+		std::string runName() {
+			return _path + ".run" + std::to_string(_run_names++);
+		}
+
+		void start(int board_size) {
+			_symmetries.emplace(board_size);
+			_stride = strideFor(_symmetries->numTiles());
+			_capacity = std::max<std::size_t>(_settings.memory_bytes / (_stride + sizeof(std::uint32_t)), 1);
+			_buffer.resize(_capacity * _stride);
+			_order.reserve(_capacity);
+		}
+
+		void addPosition(const Board& b, int player, bool won) {
+			if (_buffered == _capacity) spill();
+			std::uint8_t* p = &_buffer[_buffered++ * _stride];
+			const auto canonical = _symmetries->canonicalHash(b, player);
+			const std::array<std::uint32_t, 2> counts = { 1, won };
+			std::memcpy(p, &canonical.hash, sizeof(canonical.hash));
+			std::memcpy(p + 8, counts.data(), sizeof(counts));
+			for (std::size_t t = 0; t < _symmetries->numTiles(); ++t) {
+				p[tiles_offset + t] = static_cast<std::uint8_t>(_symmetries->tileCode(b, _symmetries->image(canonical.symmetry, static_cast<int>(t)), player));
+			}
+			std::fill(p + tiles_offset + _symmetries->numTiles(), p + _stride, std::uint8_t(0));
+			++_report.positions;
+		}
+
+		//Sorts the buffer and writes it out as a run
+		void spill() {
+			if (_buffered == 0) return;
+			_order.resize(_buffered);
+			for (std::size_t i = 0; i < _buffered; ++i) _order[i] = static_cast<std::uint32_t>(i);
+			std::ranges::sort(_order, [&](std::uint32_t a, std::uint32_t b) {
+				return detail::compare(&_buffer[a * _stride], &_buffer[b * _stride], _stride) < 0;
+			});
+			_runs.push_back(runName());
+			std::ofstream out(_runs.back(), std::ios::binary);
+			detail::MergingWriter writer(out, _stride);
+			for (auto i : _order) writer.add(&_buffer[i * _stride]);
+			writer.flush();
+			out.close();
+			if (!out) _failed = true;
+			_buffered = 0;
+			++_report.runs;
+		}
+
+	public:
+		Builder(std::string path, const Settings& settings) : _path(std::move(path)), _settings(settings) {
+			//merging fewer than 2 runs at a time never gets down to one
+			_settings.merge_fan_in = std::max<std::size_t>(_settings.merge_fan_in, 2);
+			if (settings.board_size > 0) start(settings.board_size);
+		}
+
+		Builder(const Builder&) = delete;
+
+		~Builder() {
+			for (auto& run : _runs) std::filesystem::remove(run);
+		}
+
+		//Adds every position of the game
+		void add(const records::RecordView& r) {
+			if (!_symmetries) start(r.board_size);
+			if (r.board_size != _symmetries->size()) {
+				++_report.skipped_games;
+				return;
+			}
+			++_report.games;
+			Board b(r.board_size);
+			int player = 0;
+			bool over = false;
+			r.forEachMove([&](TriCoord c) {
+				if (over) return;
+				addPosition(b, player, r.winner == player);
+				over = playMove(b, c, player) != MoveEnd::Continues;
+				player = nextActivePlayer(b, player, r.players);
+			});
+		}
+
+		//Merges everything into the corpus file, nothing if it couldn't be written
+		std::optional<Report> finish() {
+			spill();
+			if (_failed) return {};
+			//the merges get the memory of the buffer
+			_buffer = {};
+			_order = {};
+			while (_runs.size() > _settings.merge_fan_in) {
+				std::vector<std::string> group(_runs.begin(), _runs.begin() + _settings.merge_fan_in);
+				_runs.erase(_runs.begin(), _runs.begin() + _settings.merge_fan_in);
+				_runs.push_back(runName());
+				std::ofstream out(_runs.back(), std::ios::binary);
+				detail::mergeRuns(group, out, _stride, _settings.memory_bytes);
+				out.close();
+				for (auto& run : group) std::filesystem::remove(run);
+				if (!out) return {};
+			}
+
+			std::ofstream out(_path, std::ios::binary | std::ios::trunc);
+			Header header{};
+			std::memcpy(header.magic, file_magic.data(), file_magic.size());
+			header.version = file_version;
+			header.board_size = _symmetries ? static_cast<std::uint32_t>(_symmetries->size()) : 0;
+			header.stride = static_cast<std::uint32_t>(_stride);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			header.positions = detail::mergeRuns(_runs, out, _stride, _settings.memory_bytes);
+			out.seekp(0);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.close();
+			if (!out) return {};
+
+			for (auto& run : _runs) std::filesystem::remove(run);
+			_runs.clear();
+			_report.unique = header.positions;
+			_report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+			return _report;
+		}
+	};
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <optional>
+#include "board.hpp"
+#include "symmetry.hpp"
+#include "search.hpp"
+
+namespace search {
+
+	//Proves wins and losses exactly with depth-first proof-number search (df-pn).
+	//
+	//Instead of searching to a fixed depth it keeps growing the part of the tree that is closest to being settled:
+	//proof numbers count how many more positions at least have to be solved to prove a win for the attacker,
+	//disproof numbers how many to refute it. Forced lines, where the defender only has a few moves that don't lose at once,
+	//have small numbers and get followed to their end however long they are, which fixed depth searches can't afford.
+	//
+	//Positions are looked up in a fixed size transposition table by their symmetry-canonical hash, so memory use is bounded
+	//no matter how long the search runs. Explosions that never stop count as a draw.
+	class ProofSolver {
+	public:
+		enum class Result {
+			Win, //for the player to move
+			Loss,
+			Draw,
+			Unknown //ran out of nodes
+		};
+
+		struct Solution {
+			Result result = Result::Unknown;
+			std::vector<TriCoord> principal_variation; //as far as the table still remembers it
+			long long nodes = 0;
+		};
+
+	private:
+		static constexpr std::uint32_t infinity = 1u << 30;
+
+		struct Entry {
+			std::uint64_t hash = 0;
+			std::uint32_t pn = 1, dn = 1;
+			std::uint64_t work = 0; //nodes spent below this position, decides which entries get replaced
+		};
+
+		struct Child {
+			TriCoord move;
+			Board board;
+			std::uint64_t hash;
+			std::uint32_t pn, dn;
+			bool terminal; //decided by the move itself
+		};
+
+		std::vector<Entry> _table; //pairs of slots, the one with less work in it gets replaced
+		std::optional<BoardSymmetries> _symmetries;
+		int _attacker = 0;
+		long long _nodes = 0;
+		long long _budget = 0;
+
+		static std::uint32_t add(std::uint32_t a, std::uint32_t b) {
+			return std::min(a + b, infinity);
+		}
+
+		std::uint64_t hash(const Board& b, int player) const {
+			//the same pieces are a different question depending on who is attacking
+			return _symmetries->canonicalHash(b, player).hash ^ (player == _attacker ? 0x9E3779B97F4A7C15 : 0);
+		}
+
+		Entry* slotsOf(std::uint64_t hash) {
+			return &_table[(hash % (_table.size() / 2)) * 2];
+		}
+
+		Entry lookup(std::uint64_t hash) {
+			Entry* slots = slotsOf(hash);
+			for (int i = 0; i < 2; ++i) {
+				if (slots[i].hash == hash && slots[i].work > 0) return slots[i];
+			}
+			return { hash };
+		}
+
+		void store(const Entry& e) {
+			Entry* slots = slotsOf(e.hash);
+			Entry* target = slots[0].hash == e.hash ? &slots[0] : slots[1].hash == e.hash ? &slots[1] : slots[0].work <= slots[1].work ? &slots[0] : &slots[1];
+			*target = e;
+		}
+
+		void children(const Board& b, int player, std::vector<Child>& out) {
+			std::vector<TriCoord> moves;
+			legalMoves(b, player, moves);
+			out.clear();
+			for (auto c : moves) {
+				Child child{ c, b, 0, 1, 1, false };
+				switch (playMove(child.board, c, player)) {
+				case MoveEnd::Won:
+					child.terminal = true;
+					child.pn = player == _attacker ? 0 : infinity;
+					child.dn = player == _attacker ? infinity : 0;
+					break;
+				case MoveEnd::Endless:
+					child.terminal = true;
+					child.pn = infinity;
+					child.dn = 0;
+					break;
+				default:
+					child.hash = hash(child.board, 1 - player);
+				}
+				out.push_back(std::move(child));
+			}
+		}
+
+		//Searches until the position's numbers reach one of the thresholds or the node budget is used up
+		void mid(const Board& b, int player, std::uint64_t h, std::uint32_t pn_threshold, std::uint32_t dn_threshold) {
+			Entry entry = lookup(h);
+			if (entry.pn >= pn_threshold || entry.dn >= dn_threshold) return;
+			const long long start_nodes = _nodes++;
+			const bool attacking = player == _attacker;
+
+			std::vector<Child> kids;
+			children(b, player, kids);
+			if (kids.empty()) {
+				entry.pn = attacking ? infinity : 0;
+				entry.dn = attacking ? 0 : infinity;
+			}
+
+			while (!kids.empty()) {
+				//the attacker needs one proven move, the defender needs every move refuted
+				std::uint32_t pn = attacking ? infinity : 0, dn = attacking ? 0 : infinity;
+				std::size_t best = 0;
+				std::uint32_t best_number = infinity, second_number = infinity;
+				for (std::size_t i = 0; i < kids.size(); ++i) {
+					auto& kid = kids[i];
+					if (!kid.terminal) {
+						Entry e = lookup(kid.hash);
+						kid.pn = e.pn;
+						kid.dn = e.dn;
+					}
+					const std::uint32_t number = attacking ? kid.pn : kid.dn;
+					if (attacking) {
+						pn = std::min(pn, kid.pn);
+						dn = add(dn, kid.dn);
+					}
+					else {
+						pn = add(pn, kid.pn);
+						dn = std::min(dn, kid.dn);
+					}
+					if (number < best_number) {
+						second_number = best_number;
+						best_number = number;
+						best = i;
+					}
+					else if (number < second_number) {
+						second_number = number;
+					}
+				}
+				entry.pn = pn;
+				entry.dn = dn;
+				if (pn >= pn_threshold || dn >= dn_threshold || _nodes >= _budget) break;
+
+				auto& kid = kids[best];
+				if (attacking) {
+					mid(kid.board, 1 - player, kid.hash, std::min(pn_threshold, add(second_number, 1)), add(dn_threshold - dn, kid.dn));
+				}
+				else {
+					mid(kid.board, 1 - player, kid.hash, add(pn_threshold - pn, kid.pn), std::min(dn_threshold, add(second_number, 1)));
+				}
+			}
+
+			entry.work = static_cast<std::uint64_t>(_nodes - start_nodes);
+			store(entry);
+		}
+
+		//Proof and disproof number of a win for attacker
+		Entry search(const Board& b, int player, int attacker) {
+			_attacker = attacker;
+			const auto h = hash(b, player);
+			mid(b, player, h, infinity, infinity);
+			return lookup(h);
+		}
+
+		//Follows proven moves of the winner and the defender's most stubborn replies
+		std::vector<TriCoord> principalVariation(Board b, int player, int winner) {
+			_attacker = winner;
+			std::vector<TriCoord> pv;
+			std::vector<Child> kids;
+			for (int depth = 0; depth < 200; ++depth) {
+				children(b, player, kids);
+				const Child* chosen = nullptr;
+				std::uint64_t most_work = 0;
+				for (auto& kid : kids) {
+					if (kid.terminal) {
+						if (player == winner && kid.pn == 0) {
+							pv.push_back(kid.move);
+							return pv;
+						}
+						continue;
+					}
+					Entry e = lookup(kid.hash);
+					if (e.work == 0 || e.pn != 0) continue;
+					//winner: any proven move, the one settled with the least work. defender: the one that took the most work to refute
+					if (!chosen || (player == winner ? e.work < most_work : e.work > most_work)) {
+						chosen = &kid;
+						most_work = e.work;
+					}
+				}
+				if (!chosen) break;
+				pv.push_back(chosen->move);
+				b = chosen->board;
+				player = 1 - player;
+			}
+			return pv;
+		}
+
+	public:
+		explicit ProofSolver(std::size_t table_bytes = std::size_t(64) << 20) : _table(std::max<std::size_t>(table_bytes / sizeof(Entry) / 2, 1) * 2) {}
+
+		//Two player positions only. Tries to prove a win for the player to move, then for the opponent;
+		//a position where both fail within the budget is a draw if both searches finished.
+		Solution solve(const Board& b, int player, long long node_budget) {
+			if (!_symmetries || _symmetries->size() != b.size()) {
+				_symmetries.emplace(b.size());
+				std::ranges::fill(_table, Entry{});
+			}
+			_nodes = 0;
+			_budget = node_budget;
+			Solution solution;
+
+			const Entry win = search(b, player, player);
+			if (win.pn == 0) {
+				solution.result = Result::Win;
+				solution.principal_variation = principalVariation(b, player, player);
+			}
+			else {
+				const Entry loss = search(b, player, 1 - player);
+				if (loss.pn == 0) {
+					solution.result = Result::Loss;
+					solution.principal_variation = principalVariation(b, player, 1 - player);
+				}
+				else if (win.dn == 0 && loss.dn == 0) {
+					solution.result = Result::Draw;
+				}
+			}
+			solution.nodes = _nodes;
+			return solution;
+		}
+	};
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "tournament.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#define EXPLODINGTILES_HAS_PROCESSES 1
+#endif
+
+#ifdef EXPLODINGTILES_HAS_PROCESSES
+
+//Tournament games spread over worker processes instead of threads, so a crashing or leaking strategy
+//only takes down its own worker. Workers are forked from the coordinator and share one anonymous
+//memory mapping with it that holds the state of every game:
+//	pending -> claimed by a worker -> done, with the result stored next to it
+//Every worker also pushes the games it finished on its own ring buffer so the coordinator can report progress as they come in.
+//When a worker dies its claimed game goes back to pending and a new worker is started, finished games are never lost.
+//A worker can also die between claiming a game and saying which one it claimed, those games are found once all the
+//workers are gone and get played by a new round of workers.
+namespace distributed {
+
+	struct Settings {
+		int processes = 1;
+		double crash_rate = 0; //chance of a worker aborting in the middle of a game, for testing the recovery
+		int games_per_process = 0; //workers exit after this many games and get replaced, 0 for no limit
+	};
+
+	namespace detail {
+		enum GameStatus : std::uint32_t { pending, claimed, done };
+
+		struct GameSlot {
+			std::atomic<std::uint32_t> status;
+			std::int32_t winner; //-1 for a draw
+			std::int64_t steps;
+		};
+
+		constexpr std::size_t ring_size = 1024;
+
+		//Single producer ring, written by whichever process currently plays as this worker.
+		//A worker dying halfway through a push never publishes it, so the coordinator never reads a torn entry.
+		struct WorkerSlot {
+			std::atomic<std::int64_t> current_game; //-1 when not playing
+			std::atomic<std::uint64_t> head; //next entry the worker writes
+			std::atomic<std::uint64_t> tail; //next entry the coordinator reads
+			std::int64_t ring[ring_size];
+		};
+
+		//All shared state lives in one mapping laid out as the next game counter, worker slots, game slots
+		class SharedState {
+			void* memory = nullptr;
+			std::size_t length = 0;
+			std::int64_t num_games;
+			int num_workers;
+
+		public:
+			std::atomic<std::int64_t>* next_game; //games before this have been handed out at least once
+			WorkerSlot* workers;
+			GameSlot* games;
+
+			SharedState(std::int64_t num_games, int num_workers) : num_games(num_games), num_workers(num_workers) {
+				length = sizeof(std::atomic<std::int64_t>) + sizeof(WorkerSlot) * num_workers + sizeof(GameSlot) * num_games;
+				memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+				if (memory == MAP_FAILED) throw std::bad_alloc();
+
+				auto* bytes = static_cast<char*>(memory);
+				next_game = new (bytes) std::atomic<std::int64_t>(0);
+				bytes += sizeof(std::atomic<std::int64_t>);
+				workers = reinterpret_cast<WorkerSlot*>(bytes);
+				for (int i = 0; i < num_workers; ++i) {
+					auto* w = new (workers + i) WorkerSlot;
+					w->current_game.store(-1);
+					w->head.store(0);
+					w->tail.store(0);
+				}
+				bytes += sizeof(WorkerSlot) * num_workers;
+				games = reinterpret_cast<GameSlot*>(bytes);
+				for (std::int64_t i = 0; i < num_games; ++i) new (games + i) GameSlot{ pending, -1, 0 };
+			}
+
+			SharedState(const SharedState&) = delete;
+			SharedState& operator=(const SharedState&) = delete;
+
+			~SharedState() {
+				munmap(memory, length);
+			}
+
+			//Hands out games in order, then looks for games that were given back by crashed workers
+			std::optional<std::int64_t> claim() {
+				for (auto i = next_game->load(); i < num_games; i = next_game->load()) {
+					if (next_game->compare_exchange_weak(i, i + 1)) {
+						std::uint32_t expected = pending;
+						if (games[i].status.compare_exchange_strong(expected, claimed)) return i;
+					}
+				}
+				for (std::int64_t i = 0; i < num_games; ++i) {
+					std::uint32_t expected = pending;
+					if (games[i].status.compare_exchange_strong(expected, claimed)) return i;
+				}
+				return {};
+			}
+
+			void finish(int worker, std::int64_t game, std::optional<int> winner, std::int64_t steps) {
+				games[game].winner = winner.value_or(-1);
+				games[game].steps = steps;
+				games[game].status.store(done);
+
+				//wait for the coordinator if the ring is full, it's only there for progress reports
+				WorkerSlot& w = workers[worker];
+				const auto position = w.head.load();
+				while (position - w.tail.load() >= ring_size) usleep(100);
+				w.ring[position % ring_size] = game;
+				w.head.store(position + 1);
+			}
+
+			//Calls on_done with every game that got pushed since the last call
+			void drain(auto on_done) {
+				for (int i = 0; i < num_workers; ++i) {
+					WorkerSlot& w = workers[i];
+					const auto head = w.head.load();
+					for (auto position = w.tail.load(); position < head; ++position) {
+						on_done(w.ring[position % ring_size]);
+					}
+					w.tail.store(head);
+				}
+			}
+
+			bool anyPending() const {
+				for (std::int64_t i = 0; i < num_games; ++i) {
+					if (games[i].status.load() == pending) return true;
+				}
+				return false;
+			}
+
+			//Games claimed by workers that died before they could say so go back to pending, only while no worker runs
+			bool requeueUnfinished() {
+				bool any = false;
+				for (std::int64_t i = 0; i < num_games; ++i) {
+					std::uint32_t expected = claimed;
+					if (games[i].status.compare_exchange_strong(expected, pending)) any = true;
+				}
+				return any;
+			}
+
+			//Game a dead worker was playing goes back to pending
+			void release(int worker) {
+				auto game = workers[worker].current_game.exchange(-1);
+				if (game < 0) return;
+				std::uint32_t expected = claimed;
+				games[game].status.compare_exchange_strong(expected, pending);
+			}
+		};
+
+		[[noreturn]] void workerMain(SharedState& shared, int worker, const tournament::Settings& settings, const tournament::Plan& plan, const Settings& process_settings) {
+			std::default_random_engine crash_random(static_cast<std::default_random_engine::result_type>(getpid()));
+			int played = 0;
+			while (process_settings.games_per_process == 0 || played < process_settings.games_per_process) {
+				auto game = shared.claim();
+				if (!game) break;
+				shared.workers[worker].current_game.store(*game);
+
+				if (process_settings.crash_rate > 0 && std::uniform_real_distribution<>()(crash_random) < process_settings.crash_rate) {
+					std::abort();
+				}
+
+				auto outcome = tournament::playScheduledGame(settings, plan, *game);
+				shared.finish(worker, *game, outcome.winner, outcome.steps);
+				shared.workers[worker].current_game.store(-1);
+				++played;
+			}
+			tournament::finishStrategies(settings);
+			std::_Exit(0);
+		}
+	}
+
+	//Same games and results as tournament::run, but played by worker processes.
+	//on_game(results so far) is called by the coordinator as finished games come in.
+	tournament::Results run(const tournament::Settings& settings, const Settings& process_settings, auto on_game) {
+		auto plan = tournament::makePlan(settings);
+		tournament::Results results;
+		results.pairings = plan.pairings;
+		const auto start = std::chrono::steady_clock::now();
+
+		detail::SharedState shared(plan.total_games, process_settings.processes);
+		std::vector<pid_t> workers(process_settings.processes, -1);
+
+		auto spawn = [&](int worker) {
+			std::cout.flush();
+			pid_t pid = fork();
+			if (pid == 0) detail::workerMain(shared, worker, settings, plan, process_settings);
+			workers[worker] = pid;
+		};
+		for (int w = 0; w < process_settings.processes; ++w) spawn(w);
+
+		//a worker can die between finishing a game and pushing it, those get picked up from the game slots at the end
+		std::vector<bool> collected(plan.total_games, false);
+		auto collect = [&](std::int64_t game) {
+			if (collected[game] || shared.games[game].status.load() != detail::done) return;
+			collected[game] = true;
+			auto& slot = shared.games[game];
+			tournament::addOutcome(results, plan, settings, game, { slot.winner < 0 ? std::optional<int>{} : slot.winner, slot.steps });
+			on_game(std::as_const(results));
+		};
+
+		int running = process_settings.processes;
+		while (true) {
+			while (running > 0) {
+				shared.drain(collect);
+				int status = 0;
+				pid_t pid = waitpid(-1, &status, WNOHANG);
+				if (pid <= 0) {
+					usleep(1000);
+					continue;
+				}
+				int worker = static_cast<int>(std::ranges::find(workers, pid) - workers.begin());
+				if (worker == static_cast<int>(workers.size())) continue;
+				shared.release(worker);
+				const bool crashed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+				if (crashed) {
+					std::cerr << "Worker " << pid << " died, restarting it\n";
+				}
+				if (shared.anyPending() && (crashed || process_settings.games_per_process > 0)) {
+					spawn(worker);
+				}
+				else {
+					workers[worker] = -1;
+					--running;
+				}
+			}
+			if (!shared.requeueUnfinished()) break;
+			std::cerr << "Some games were lost with their workers, playing them again\n";
+			for (int w = 0; w < process_settings.processes; ++w) spawn(w);
+			running = process_settings.processes;
+		}
+		shared.drain(collect);
+		for (std::int64_t game = 0; game < plan.total_games; ++game) {
+			collect(game);
+		}
+
+		results.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return results;
+	}
+}
+
+#endif
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <istream>
+#include <ostream>
+#include <optional>
+#include <algorithm>
+#include <condition_variable>
+#include "board.hpp"
+#include "search.hpp"
+#include "parallel_search.hpp"
+
+//Line based text protocol for driving the search from another program, in the spirit of UCI. Moves are x,y,r.
+//
+//	uci                          answered with id lines and uciok
+//	isready                      answered with readyok right away, also during a search
+//	newgame                      forgets what earlier searches put in the transposition table, after saving it to the table file
+//	position <size> [moves ...]  the empty board of size, then the moves, players taking turns starting with player 0
+//	moves ...                    plays more moves on the current position
+//	go [depth n] [movetime ms] [nodes n] [infinite]
+//	                             searches the position in the background, with info lines after every depth
+//	                             (depth, score, nodes, nps, time in ms, pv) and bestmove at the end.
+//	                             depth is at most 254, deeper is searched 254 deep.
+//	                             infinite searches until stop, ignoring the other limits, and only then sends bestmove
+//	stop                         ends the search, its bestmove comes before anything else is answered
+//	                             newgame, position, moves and go end a running search the same way
+//	quit                         saves the table to the table file, if there is one
+//
+//Errors are reported as "info string ..." lines and leave the position as it was.
+namespace engine {
+
+	class TextEngine {
+		std::ostream& _out;
+		std::mutex _out_mutex; //the search thread writes info and bestmove lines
+		search::ParallelSearch::Settings _settings;
+		std::optional<search::ParallelSearch> _search;
+		std::jthread _thread;
+		Board _board{ 3 };
+		int _player = 0;
+		bool _over = false;
+
+		void send(const std::string& line) {
+			std::scoped_lock lock(_out_mutex);
+			_out << line << std::endl;
+		}
+
+		static std::string format(TriCoord c) {
+			return std::to_string(c.x) + ',' + std::to_string(c.y) + ',' + (c.R ? '1' : '0');
+		}
+
+		static std::optional<TriCoord> parseMove(const std::string& word) {
+			const auto first = word.find(','), second = word.find(',', first + 1);
+			if (first == std::string::npos || second == std::string::npos || word.find(',', second + 1) != std::string::npos) return {};
+			try {
+				const auto r = word.substr(second + 1);
+				if (r != "0" && r != "1") return {};
+				return TriCoord{ std::stoi(word.substr(0, first)), std::stoi(word.substr(first + 1, second - first - 1)), r == "1" };
+			}
+			catch (const std::exception&) {
+				return {};
+			}
+		}
+
+		//Plays the moves on a copy of b, which becomes the position only if they were all legal
+		void playMoves(std::istringstream& in, Board b, int player, bool over) {
+			std::string word;
+			while (in >> word) {
+				auto c = parseMove(word);
+				if (!c) {
+					send("info string not a move: " + word);
+					return;
+				}
+				if (over || !b.inBounds(*c) || (b[*c].num != 0 && b[*c].player != player)) {
+					send("info string illegal move: " + word);
+					return;
+				}
+				over = playMove(b, *c, player) != MoveEnd::Continues;
+				player = nextActivePlayer(b, player, 2);
+			}
+			_board = b;
+			_player = player;
+			_over = over;
+		}
+
+		void go(std::istringstream& in) {
+			int depth = 32;
+			long long movetime = 0, nodes = 0;
+			bool infinite = false;
+			std::string word;
+			while (in >> word) {
+				long long value = 0;
+				if (word != "infinite" && !(in >> value)) {
+					send("info string go needs a number after " + word);
+					return;
+				}
+				if (word == "depth") depth = static_cast<int>(std::clamp<long long>(value, 1, search::TranspositionTable::max_depth));
+				else if (word == "movetime") movetime = value;
+				else if (word == "nodes") nodes = value;
+				else if (word == "infinite") infinite = true;
+				else {
+					send("info string unknown go option " + word);
+					return;
+				}
+			}
+			if (_over && !infinite) {
+				send("bestmove none");
+				return;
+			}
+			if (!_search) _search.emplace(_settings);
+			if (infinite) _search->setLimits(depth, std::chrono::milliseconds(0), 0, true);
+			else _search->setLimits(depth, std::chrono::milliseconds(movetime), nodes);
+			_search->setInfoListener([this](const search::ParallelSearch::Info& info) {
+				const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(info.elapsed).count();
+				const double seconds = std::chrono::duration<double>(info.elapsed).count();
+				std::string line = "info depth " + std::to_string(info.depth) + " score " + std::to_string(info.best.score)
+					+ " nodes " + std::to_string(info.nodes) + " nps " + std::to_string(static_cast<long long>(seconds > 0 ? info.nodes / seconds : 0))
+					+ " time " + std::to_string(ms);
+				if (info.best.move) line += " pv " + format(*info.best.move);
+				send(line);
+			});
+			_thread = std::jthread([this, b = _board, player = _player, over = _over, infinite](std::stop_token stop) {
+				search::Result result{};
+				if (!over) result = _search->search(b, player, stop);
+				if (infinite) {
+					//bestmove only comes after stop, even when there was nothing left to search
+					std::mutex m;
+					std::condition_variable_any never;
+					std::unique_lock lock(m);
+					never.wait(lock, stop, [] {return false; });
+				}
+				if (!result.move && !over) {
+					//stopped before the first depth was done
+					std::vector<TriCoord> moves;
+					search::legalMoves(b, player, moves);
+					if (!moves.empty()) result.move = moves.front();
+				}
+				send(result.move ? "bestmove " + format(*result.move) : "bestmove none");
+			});
+		}
+
+		void stop() {
+			if (_thread.joinable()) {
+				_thread.request_stop();
+				_thread.join();
+			}
+		}
+
+	public:
+		explicit TextEngine(std::ostream& out, const search::ParallelSearch::Settings& settings = {}) : _out(out), _settings(settings) {}
+
+		TextEngine(const TextEngine&) = delete;
+
+		~TextEngine() {
+			stop();
+			if (_search) _search->save();
+		}
+
+		//False once the line was quit
+		bool handle(const std::string& line) {
+			std::istringstream in(line);
+			std::string command;
+			if (!(in >> command)) return true;
+
+			if (command == "quit") {
+				stop();
+				return false;
+			}
+			if (command == "stop") {
+				stop();
+				return true;
+			}
+			if (command == "isready") {
+				send("readyok");
+				return true;
+			}
+			if (command == "uci") {
+				send("id name ExplodingTiles");
+				send("uciok");
+				return true;
+			}
+			//everything else ends a running search first, so its bestmove is answered before anything about the new command
+			stop();
+			if (command == "newgame") {
+				if (_search) _search->save();
+				_search.reset();
+			}
+			else if (command == "position") {
+				int size = 0;
+				if (!(in >> size) || size < 1 || size > 16) {
+					send("info string position needs a board size from 1 to 16");
+					return true;
+				}
+				std::string word;
+				if (in >> word && word != "moves") {
+					send("info string expected moves after the board size");
+					return true;
+				}
+				playMoves(in, Board(size), 0, false);
+			}
+			else if (command == "moves") {
+				playMoves(in, _board, _player, _over);
+			}
+			else if (command == "go") {
+				go(in);
+			}
+			else {
+				send("info string unknown command " + command);
+			}
+			return true;
+		}
+	};
+
+	//Reads commands until quit or the end of the input
+	int run(std::istream& in, std::ostream& out, const search::ParallelSearch::Settings& settings) {
+		TextEngine engine(out, settings);
+		std::string line;
+		while (std::getline(in, line)) {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!engine.handle(line)) break;
+		}
+		return 0;
+	}
+}
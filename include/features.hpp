@@ -0,0 +1,194 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "board.hpp"
+#include "weights.hpp"
+
+//Per-tile features of a whole board from one player's point of view, stored as one byte per tile so
+//that every feature is computed 8 tiles at a time with plain 64 bit integer operations (SIMD within a register),
+//which compilers widen further where vector units are available.
+//
+//Up (R) and down triangles get a plane each, indexed by (x+1) + (y+1)*stride so that out of bounds
+//neighbors land on zeroed padding. A down triangle's neighbors are then up[i], up[i-1] and up[i-stride],
+//an up triangle's are down[i], down[i+1] and down[i+stride].
+class BoardFeatures {
+public:
+	struct Plane {
+		std::vector<std::uint8_t> allowed; //0 outside of the board
+		std::vector<std::uint8_t> num;
+		std::vector<std::uint8_t> occupied;
+		std::vector<std::uint8_t> owned;
+		std::vector<std::uint8_t> critical; //one piece away from exploding
+		std::vector<std::uint8_t> enemy_critical;
+		std::vector<std::uint8_t> threatened; //owned and next to an enemy tile that's about to explode
+		std::vector<std::uint8_t> safe_critical; //owned critical tile that isn't threatened
+		std::vector<std::uint8_t> occupied_neighbors; //how many neighboring tiles have pieces on them
+	};
+
+private:
+	using Word = std::uint64_t;
+	static constexpr Word ones = 0x0101010101010101;
+
+	int _size = -1;
+	int _stride = 0;
+	std::size_t _margin = 0; //every plane starts and ends with this many zero bytes so neighbor reads never leave it
+	std::size_t _words = 0; //number of 8 tile words covering the board
+	Plane _down, _up;
+
+	//The loops below work on local pointers to the planes, a store through uint8_t could otherwise
+	//change the vectors themselves and force reloading their data pointers after every store.
+	static Word load(const std::uint8_t* p) {
+		Word w;
+		std::memcpy(&w, p, sizeof(w));
+		return w;
+	}
+
+	static void store(std::uint8_t* p, Word w) {
+		std::memcpy(p, &w, sizeof(w));
+	}
+
+	//1 in every byte that isn't 0
+	static Word nonZero(Word w) {
+		w |= w >> 4;
+		w |= w >> 2;
+		w |= w >> 1;
+		return w & ones;
+	}
+
+	//adds up the bytes of a word, the total has to stay below 256
+	static int byteSum(Word w) {
+		return static_cast<int>((w * ones) >> 56);
+	}
+
+	void setGeometry(const Board& b) {
+		_size = b.size();
+		_stride = _size * 2 + 2;
+		_margin = _stride + sizeof(Word);
+		const std::size_t tiles = static_cast<std::size_t>(_stride) * _stride;
+		_words = (tiles + sizeof(Word) - 1) / sizeof(Word);
+		for (Plane* p : { &_down, &_up }) {
+			for (auto* v : { &p->allowed, &p->num, &p->occupied, &p->owned, &p->critical, &p->enemy_critical, &p->threatened, &p->safe_critical, &p->occupied_neighbors }) {
+				v->assign(_margin + _words * sizeof(Word) + _margin, 0);
+			}
+		}
+		b.iterTiles([&](TriCoord c) {
+			plane(c.R).allowed[index(c)] = static_cast<std::uint8_t>(b.allowedPieces(c));
+			return true;
+		});
+	}
+
+	//neighbor features of every tile in to, gathered from the opposite plane at the given offsets
+	void neighborPass(Plane& to, const Plane& from, std::ptrdiff_t a, std::ptrdiff_t b, std::ptrdiff_t c) {
+		const std::uint8_t* owned = to.owned.data() + _margin;
+		const std::uint8_t* critical = to.critical.data() + _margin;
+		const std::uint8_t* enemy_critical = from.enemy_critical.data() + _margin;
+		const std::uint8_t* occupied = from.occupied.data() + _margin;
+		std::uint8_t* threatened = to.threatened.data() + _margin;
+		std::uint8_t* occupied_neighbors = to.occupied_neighbors.data() + _margin;
+		std::uint8_t* safe_critical = to.safe_critical.data() + _margin;
+		for (std::size_t i = 0; i < _words * sizeof(Word); i += sizeof(Word)) {
+			const Word o = load(owned + i);
+			const Word t = o & (load(enemy_critical + i + a) | load(enemy_critical + i + b) | load(enemy_critical + i + c));
+			store(threatened + i, t);
+			store(occupied_neighbors + i, load(occupied + i + a) + load(occupied + i + b) + load(occupied + i + c));
+			store(safe_critical + i, o & load(critical + i) & (t ^ ones));
+		}
+	}
+
+public:
+	std::size_t index(TriCoord c) const {
+		return _margin + (c.x + 1) + (c.y + 1) * static_cast<std::size_t>(_stride);
+	}
+
+	const Plane& plane(bool R) const {
+		return R ? _up : _down;
+	}
+
+	Plane& plane(bool R) {
+		return R ? _up : _down;
+	}
+
+	void extract(const Board& b, int player) {
+		if (b.size() != _size) setGeometry(b);
+
+		//Board stores rows of interleaved down/up tiles, split them into the two planes.
+		//Its out of bounds slots are never touched so they come through as empty tiles.
+		auto tiles = b.tiles();
+		const int row = _size * 4;
+		for (int R = 0; R < 2; ++R) {
+			Plane& p = plane(R);
+			std::uint8_t* nums = p.num.data();
+			std::uint8_t* owned = p.owned.data();
+			for (int y = 0; y < _size * 2; ++y) {
+				const TileState* in = tiles.data() + y * row + R;
+				const std::size_t out = index({ 0, y, false });
+				for (int x = 0; x < _size * 2; ++x) {
+					nums[out + x] = static_cast<std::uint8_t>(in[x * 2].num);
+					owned[out + x] = in[x * 2].player == player;
+				}
+			}
+
+			const std::uint8_t* allowed = p.allowed.data();
+			std::uint8_t* occupied = p.occupied.data();
+			std::uint8_t* critical = p.critical.data();
+			std::uint8_t* enemy_critical = p.enemy_critical.data();
+			for (std::size_t i = _margin; i < _margin + _words * sizeof(Word); i += sizeof(Word)) {
+				const Word num = load(nums + i);
+				const Word occ = nonZero(num);
+				const Word crit = occ & (nonZero(num ^ load(allowed + i)) ^ ones);
+				const Word own = load(owned + i) & occ;
+				store(occupied + i, occ);
+				store(owned + i, own);
+				store(critical + i, crit);
+				store(enemy_critical + i, crit & (own ^ ones));
+			}
+		}
+
+		neighborPass(_down, _up, 0, -1, -_stride);
+		neighborPass(_up, _down, 0, 1, _stride);
+	}
+
+	//Score of AI::heuristic for the extracted board, the sum of every feature count times its weight:
+	//	owned pieces
+	//	threatened tiles, and threatened tiles that were about to explode themselves
+	//	non-threatened tiles
+	//	safe critical tiles, the pieces on them and the occupied tiles next to them they would take
+	//
+	//Per tile every count stays below 4, so 8 tiles still fit in a byte sum.
+	int heuristicScore(const HeuristicWeights& w = {}) const {
+		int pieces = 0, owned_tiles = 0, threatened_tiles = 0, threatened_critical = 0;
+		int safe_critical_tiles = 0, safe_critical_pieces = 0, safe_critical_neighbors = 0;
+		for (const Plane* p : { &_down, &_up }) {
+			const std::uint8_t* owned = p->owned.data();
+			const std::uint8_t* threatened = p->threatened.data();
+			const std::uint8_t* safe_critical = p->safe_critical.data();
+			const std::uint8_t* critical = p->critical.data();
+			const std::uint8_t* nums = p->num.data();
+			const std::uint8_t* occupied_neighbors = p->occupied_neighbors.data();
+			for (std::size_t i = _margin; i < _margin + _words * sizeof(Word); i += sizeof(Word)) {
+				const Word own = load(owned + i);
+				const Word threat = load(threatened + i);
+				const Word safe_crit = load(safe_critical + i);
+				const Word num = load(nums + i);
+				//turns 0/1 bytes into 0/0xFF masks, no byte can carry into the next
+				const Word owned_mask = own * 0xFF;
+				const Word safe_critical_mask = safe_crit * 0xFF;
+
+				pieces += byteSum(num & owned_mask);
+				owned_tiles += byteSum(own);
+				threatened_tiles += byteSum(threat);
+				threatened_critical += byteSum(threat & load(critical + i));
+				safe_critical_tiles += byteSum(safe_crit);
+				safe_critical_pieces += byteSum(num & safe_critical_mask);
+				safe_critical_neighbors += byteSum(load(occupied_neighbors + i) & safe_critical_mask);
+			}
+		}
+		//threatened tiles are always owned
+		return w.piece * pieces + w.safe * (owned_tiles - threatened_tiles)
+			+ w.threatened * threatened_tiles + w.threatened_critical * threatened_critical
+			+ w.safe_critical * safe_critical_tiles + w.safe_critical_piece * safe_critical_pieces
+			+ w.safe_critical_neighbor * safe_critical_neighbors;
+	}
+};
@@ -2,22 +2,75 @@
 
 #include <vector>
 #include <memory>
+#include <limits>
+#include <optional>
+#include <functional>
 #include "board.hpp"
 #include "player.hpp"
+#include "snapshot.hpp"
+
+//How a game played with BoardWithPlayers::playToCompletion or runTurns went
+struct GameResult {
+	std::optional<int> winner; //nothing while the game is still going
+	int turns = 0; //moves made
+	long long steps = 0; //moves and explosion waves, each of them one update() call
+};
+
+//A game between turns, from BoardWithPlayers::snapshot
+struct GameSnapshot {
+	BoardSnapshot board;
+	int current_player;
+};
 
 class BoardWithPlayers {
 	Board board;
 	int current_player = 0;
 	std::vector<std::unique_ptr<Player>> players{};
+	std::function<void(TriCoord, int)> on_move;
+	std::optional<BoardSnapshot> last_snapshot; //the board tracks its changes from this one on
+
+	//Puts the current player's piece down, false for illegal moves
+	bool placePiece(TriCoord c) {
+		if (!board.incTile(c, current_player)) return false;
+		if (on_move) on_move(c, current_player);
+		return true;
+	}
 
 	void makeMove(TriCoord c) {
-		if (!board.incTile(c, current_player)) return;
+		if (!placePiece(c)) return;
 		if (!board.needsUpdate())
 			nextPlayer();
 	}
 
+	//Plays one move and the explosions after it, or finishes the explosions of a move if update() left them halfway.
+	//The only way pieces change hands is the mover taking them, so the game is won exactly when the mover holds all pieces;
+	//that's checked against a running count of the pieces instead of looking at every player's total after each wave.
+	//False when the step limit is reached first.
+	bool playTurn(GameResult& result, long long& pieces, long long max_steps) {
+		if (!board.needsUpdate()) {
+			if (result.steps >= max_steps) return false;
+			++result.steps;
+			auto m = players[current_player]->update();
+			if (!m || !placePiece(*m)) return true;
+			++pieces;
+			++result.turns;
+		}
+		auto won = [&] { return pieces > 1 && board.playerTotals()[current_player] == pieces; };
+		while (board.needsUpdate() && !won()) {
+			if (result.steps >= max_steps) return false;
+			board.update_step();
+			++result.steps;
+		}
+		if (won()) {
+			result.winner = current_player;
+			return false;
+		}
+		nextPlayer();
+		return true;
+	}
+
 	void nextPlayer() {
-		current_player = (current_player + 1) % players.size();
+		current_player = nextActivePlayer(board, current_player, static_cast<int>(players.size()));
 		players[current_player]->startTurn(board, current_player);
 	}
 
@@ -31,6 +84,11 @@ public:
 		}
 	}
 
+	//f(move, player) is called for every legal move as it's made, before its explosions
+	void setMoveListener(std::function<void(TriCoord, int)> f) {
+		on_move = std::move(f);
+	}
+
 	const Board& getBoard() const { return board; }
 	int getCurrentPlayerNum() const { return current_player; }
 
@@ -55,10 +113,44 @@ public:
 	void reset() {
 		board = { board.size() };
 		current_player = 0;
+		last_snapshot.reset();
+		players[current_player]->startTurn(board, current_player);
+	}
+
+	//The game as it is now, only between turns. Shares every tile the turns since the last snapshot didn't touch with it,
+	//so a snapshot after every turn costs memory for the tiles that turn changed.
+	GameSnapshot snapshot() {
+		last_snapshot = last_snapshot ? last_snapshot->after(board, board.changedTiles()) : BoardSnapshot(board);
+		board.trackChanges();
+		return { *last_snapshot, current_player };
+	}
+
+	//Goes back or forward to a snapshot of this game, the player to move starts their turn again
+	void restore(const GameSnapshot& s) {
+		s.board.restore(board);
+		current_player = s.current_player;
+		last_snapshot = s.board;
+		board.trackChanges();
 		players[current_player]->startTurn(board, current_player);
 	}
 
 	std::optional<int> getWinner() const {
 		return board.isWon();
 	}
+
+	//Plays turns until the game is won or max_steps moves and explosion waves have been made.
+	//Counts steps exactly like calling update() and getWinner() in a loop would, it just doesn't stop after each of them.
+	GameResult playToCompletion(long long max_steps) {
+		return runTurns(std::numeric_limits<int>::max(), max_steps);
+	}
+
+	//Plays up to n turns, stopping early when the game is won or after max_steps steps
+	GameResult runTurns(int n, long long max_steps = std::numeric_limits<long long>::max()) {
+		GameResult result{ board.isWon() };
+		if (result.winner) return result;
+		long long pieces = 0;
+		for (int total : board.playerTotals()) pieces += total;
+		for (int turn = 0; turn < n && playTurn(result, pieces, max_steps); ++turn) {}
+		return result;
+	}
 };
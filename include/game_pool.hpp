@@ -0,0 +1,280 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <deque>
+#include <string>
+#include <span>
+#include <bit>
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <functional>
+#include <algorithm>
+#include "board.hpp"
+#include "random.hpp"
+#include "search.hpp"
+#include "player.hpp"
+
+//Thousands of two player AI games at once in one process, for load and strength testing
+namespace simulation {
+
+	//Narrows down the moves like an AI::Filter. The game's random stream picks one of the survivors, or of all moves if there are none.
+	using Strategy = std::function<std::span<TriCoord>(const Board&, std::span<TriCoord>, int)>;
+
+	Strategy toStrategy(AI::Filter auto filter) {
+		return [filter](const Board& b, std::span<TriCoord> moves, int player) {
+			return AI::applyFilter(filter, b, moves, player);
+		};
+	}
+
+	//random, greedy, biggest, heuristic or chains
+	std::optional<Strategy> strategyByName(const std::string& name) {
+		if (name == "random") return Strategy([](const Board&, std::span<TriCoord> moves, int) { return moves; });
+		if (name == "greedy") return toStrategy(AI::maxGain);
+		if (name == "biggest") return toStrategy(AI::biggestExplosion);
+		if (name == "heuristic") return toStrategy(AI::heuristic);
+		if (name == "chains") return toStrategy(AI::chains_heuristic);
+		return {};
+	}
+
+	//Counts of nanosecond durations in buckets an eighth of a power of two wide, so percentiles are within 12.5%
+	class LatencyHistogram {
+		static constexpr int sub_buckets = 8;
+		std::array<long long, 42 * sub_buckets> _counts{};
+		long long _total = 0;
+		std::int64_t _max = 0;
+
+		static std::size_t bucketOf(std::int64_t ns) {
+			if (ns < sub_buckets) return static_cast<std::size_t>(std::max<std::int64_t>(ns, 0));
+			const int power = std::bit_width(static_cast<std::uint64_t>(ns)) - 1;
+			const int sub = static_cast<int>(ns >> (power - 3)) & (sub_buckets - 1);
+			return std::min<std::size_t>((power - 2) * sub_buckets + sub, 42 * sub_buckets - 1);
+		}
+
+		//largest duration that lands in bucket
+		static std::int64_t upperBound(std::size_t bucket) {
+			if (bucket < sub_buckets) return static_cast<std::int64_t>(bucket);
+			const int power = static_cast<int>(bucket / sub_buckets) + 2;
+			const int sub = static_cast<int>(bucket % sub_buckets);
+			return (std::int64_t(sub_buckets + sub + 1) << (power - 3)) - 1;
+		}
+
+	public:
+		void record(std::chrono::nanoseconds duration) {
+			_counts[bucketOf(duration.count())]++;
+			_total++;
+			_max = std::max(_max, static_cast<std::int64_t>(duration.count()));
+		}
+
+		void merge(const LatencyHistogram& other) {
+			for (std::size_t i = 0; i < _counts.size(); ++i) _counts[i] += other._counts[i];
+			_total += other._total;
+			_max = std::max(_max, other._max);
+		}
+
+		long long count() const { return _total; }
+
+		//fraction between 0 and 1, 0.99 for the 99th percentile
+		std::chrono::nanoseconds percentile(double fraction) const {
+			const long long rank = std::max<long long>(1, static_cast<long long>(std::ceil(fraction * _total)));
+			long long seen = 0;
+			for (std::size_t i = 0; i < _counts.size(); ++i) {
+				seen += _counts[i];
+				if (seen >= rank) return std::chrono::nanoseconds(std::min(upperBound(i), _max));
+			}
+			return std::chrono::nanoseconds(_max);
+		}
+
+		std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(_max); }
+	};
+
+	//Games side by side in two flat arrays instead of a Board and players of their own on the heap each:
+	//a small header per game, and a byte per tile slot packed with packTile(). Games are only
+	//stored between turns, when no tile has more pieces than it allows.
+	class GameArena {
+	public:
+		struct Header {
+			RandomStream random;
+			std::uint32_t game = 0; //number of the game in the slot
+			std::uint16_t turns = 0;
+			std::uint8_t player = 0; //to move
+			std::uint8_t players = 0; //Board::playerTotals().size()
+		};
+
+	private:
+		std::size_t _stride;
+		std::vector<Header> _headers;
+		std::vector<std::uint8_t> _tiles;
+
+	public:
+		GameArena(int board_size, std::size_t slots) : _stride(Board(board_size).tiles().size()), _headers(slots), _tiles(slots * _stride) {}
+
+		std::size_t bytesPerGame() const {
+			return sizeof(Header) + _stride;
+		}
+
+		Header& header(std::size_t slot) {
+			return _headers[slot];
+		}
+
+		void start(std::size_t slot, std::uint32_t game, RandomStream random) {
+			_headers[slot] = { random, game };
+			std::fill_n(_tiles.begin() + slot * _stride, _stride, std::uint8_t(0));
+		}
+
+		void unpack(std::size_t slot, Board& b) const {
+			thread_local std::vector<TileState> tiles;
+			tiles.resize(_stride);
+			const std::uint8_t* packed = &_tiles[slot * _stride];
+			for (std::size_t i = 0; i < _stride; ++i) tiles[i] = unpackTile(packed[i]);
+			b.load(tiles, _headers[slot].players);
+		}
+
+		void pack(std::size_t slot, const Board& b) {
+			std::uint8_t* packed = &_tiles[slot * _stride];
+			auto tiles = b.tiles();
+			for (std::size_t i = 0; i < _stride; ++i) packed[i] = packTile(tiles[i]);
+			_headers[slot].players = static_cast<std::uint8_t>(b.playerTotals().size());
+		}
+	};
+
+	//One queue of game slots per thread. A thread plays a turn of the game at the front of its own queue and puts it back
+	//at the end, so its games take turns, and steals from the end of another queue once its own runs dry.
+	class WorkQueues {
+		struct alignas(64) Queue {
+			std::mutex mutex;
+			std::deque<std::uint32_t> slots;
+		};
+		std::vector<Queue> _queues;
+
+	public:
+		explicit WorkQueues(int threads) : _queues(threads) {}
+
+		void push(int thread, std::uint32_t slot) {
+			std::scoped_lock lock(_queues[thread].mutex);
+			_queues[thread].slots.push_back(slot);
+		}
+
+		std::optional<std::uint32_t> pop(int thread) {
+			for (std::size_t i = 0; i < _queues.size(); ++i) {
+				auto& queue = _queues[(thread + i) % _queues.size()];
+				std::scoped_lock lock(queue.mutex);
+				if (queue.slots.empty()) continue;
+				std::uint32_t slot;
+				if (i == 0) {
+					slot = queue.slots.front();
+					queue.slots.pop_front();
+				}
+				else {
+					slot = queue.slots.back();
+					queue.slots.pop_back();
+				}
+				return slot;
+			}
+			return {};
+		}
+	};
+
+	struct Settings {
+		int board_size = 3;
+		long long games = 10000;
+		int concurrent = 1000; //games in progress at once, a finished game's slot goes to the next one
+		int threads = 1;
+		int max_turns = 1000; //games still running after this many moves count as a draw, at most 65535
+		std::uint64_t seed = 0;
+	};
+
+	struct Report {
+		std::array<long long, 2> wins{}; //of the two strategies
+		long long draws = 0;
+		long long turns = 0;
+		double seconds = 0;
+		std::size_t bytes_per_game = 0;
+		LatencyHistogram latency; //of every move, from loading the game to storing it again
+
+		long long games() const { return wins[0] + wins[1] + draws; }
+	};
+
+	//Plays settings.games games between the two strategies, which take turns going first.
+	//Game i draws its moves from RandomStream(seed, i) and strategies keep no state between moves,
+	//so the results don't depend on how many threads and slots the games were spread over.
+	Report run(const std::array<Strategy, 2>& strategies, const Settings& settings) {
+		const auto slots = static_cast<std::size_t>(std::clamp<long long>(settings.concurrent, 1, std::max(settings.games, 1LL)));
+		const int threads = std::max(settings.threads, 1);
+		//the turn counter of a game is 16 bits
+		const int max_turns = std::clamp(settings.max_turns, 1, static_cast<int>(std::numeric_limits<std::uint16_t>::max()));
+		GameArena arena(settings.board_size, slots);
+		WorkQueues queues(threads);
+		for (std::size_t s = 0; s < slots; ++s) {
+			arena.start(s, static_cast<std::uint32_t>(s), RandomStream(settings.seed, s));
+			queues.push(static_cast<int>(s % threads), static_cast<std::uint32_t>(s));
+		}
+		std::atomic<long long> next_game = static_cast<long long>(slots);
+		std::atomic<long long> finished = 0;
+		std::mutex report_mutex;
+		Report report;
+		report.bytes_per_game = arena.bytesPerGame();
+
+		auto start = std::chrono::steady_clock::now();
+		auto worker = [&](int id) {
+			Board board(settings.board_size);
+			std::vector<TriCoord> moves;
+			Report local;
+			while (finished.load(std::memory_order_relaxed) < settings.games) {
+				auto slot = queues.pop(id);
+				if (!slot) {
+					std::this_thread::yield();
+					continue;
+				}
+				const auto move_start = std::chrono::steady_clock::now();
+				auto& game = arena.header(*slot);
+				arena.unpack(*slot, board);
+				search::legalMoves(board, game.player, moves);
+				const int strategy = game.player ^ (game.game & 1);
+				auto choices = strategies[strategy](board, moves, game.player);
+				if (choices.empty()) choices = moves;
+				const auto end = playMove(board, choices[game.random.below(static_cast<std::uint32_t>(choices.size()))], game.player);
+				++game.turns;
+				++local.turns;
+
+				const bool over = end != MoveEnd::Continues || game.turns >= max_turns;
+				if (!over) {
+					game.player = static_cast<std::uint8_t>(nextActivePlayer(board, game.player, 2));
+					arena.pack(*slot, board);
+				}
+				local.latency.record(std::chrono::steady_clock::now() - move_start);
+				if (!over) {
+					queues.push(id, *slot);
+					continue;
+				}
+
+				if (end == MoveEnd::Won) local.wins[strategy]++;
+				else local.draws++;
+				finished++;
+				if (const long long next = next_game++; next < settings.games) {
+					arena.start(*slot, static_cast<std::uint32_t>(next), RandomStream(settings.seed, next));
+					queues.push(id, *slot);
+				}
+			}
+			std::scoped_lock lock(report_mutex);
+			report.wins[0] += local.wins[0];
+			report.wins[1] += local.wins[1];
+			report.draws += local.draws;
+			report.turns += local.turns;
+			report.latency.merge(local.latency);
+		};
+		{
+			std::vector<std::jthread> workers;
+			for (int t = 1; t < threads; ++t) workers.emplace_back(worker, t);
+			worker(0);
+		}
+		report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return report;
+	}
+}
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <optional>
+#include "coords.hpp"
+
+//Compact binary records of finished games.
+//
+//A file starts with "ETGR" and a version byte, followed by the records back to back. Every record is its length
+//and then, all as LEB128 varints:
+//	board size, winner + 1 (0 for no winner), game number, number of players,
+//	for every player the length of their strategy name, the name and their seed,
+//	number of moves, and every move as the zigzag encoded difference of its tile slot (Board::index) to the previous move's.
+//Slot differences on a size 3 board reach about 71 either way, so a move takes one or two bytes there, about 1.3 on average.
+//Who made a move isn't stored, replaying the moves from the empty board tells.
+//
+//The length in front lets a reader step over whole records, and RecordView decodes fields straight from the buffer,
+//so scanning a file only ever touches the bytes of the fields it asks for.
+namespace records {
+
+	constexpr std::array<char, 4> file_magic = { 'E','T','G','R' };
+	constexpr std::uint8_t file_version = 1;
+	constexpr int max_players = 8;
+
+	void putVarint(std::string& out, std::uint64_t v) {
+		while (v >= 0x80) {
+			out.push_back(static_cast<char>(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back(static_cast<char>(v));
+	}
+
+	std::uint64_t zigzag(std::int64_t v) {
+		return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+	}
+
+	std::int64_t unzigzag(std::uint64_t v) {
+		return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+	}
+
+	//Reads varints and strings from a range of bytes. Reading past its end gives zeros and marks it as failed.
+	class ByteReader {
+		const std::uint8_t* _pos;
+		const std::uint8_t* _end;
+		bool _ok = true;
+
+	public:
+		ByteReader(const std::uint8_t* begin, const std::uint8_t* end) : _pos(begin), _end(end) {}
+
+		std::uint64_t varint() {
+			std::uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (_pos == _end) {
+					_ok = false;
+					return 0;
+				}
+				const std::uint8_t byte = *_pos++;
+				v |= std::uint64_t(byte & 0x7F) << shift;
+				if (byte < 0x80) return v;
+			}
+			_ok = false;
+			return 0;
+		}
+
+		std::string_view bytes(std::size_t n) {
+			if (static_cast<std::size_t>(_end - _pos) < n) {
+				_ok = false;
+				_pos = _end;
+				return {};
+			}
+			std::string_view ret(reinterpret_cast<const char*>(_pos), n);
+			_pos += n;
+			return ret;
+		}
+
+		const std::uint8_t* position() const { return _pos; }
+		const std::uint8_t* end() const { return _end; }
+		bool ok() const { return _ok; }
+	};
+
+	struct PlayerInfo {
+		std::string strategy;
+		std::uint64_t seed = 0; //for tournament games the tournament's seed, the player drew from RandomStream(seed, game, seat)
+	};
+
+	//A game being recorded. addMove() is meant for BoardWithPlayers::setMoveListener, the moves are encoded as they come in.
+	class GameRecord {
+		int _board_size;
+		std::string _moves;
+		std::uint64_t _move_count = 0;
+		std::int64_t _previous = 0;
+
+	public:
+		std::uint64_t game = 0;
+		std::vector<PlayerInfo> players;
+		std::optional<int> winner;
+
+		explicit GameRecord(int board_size) : _board_size(board_size) {}
+
+		int boardSize() const { return _board_size; }
+		std::uint64_t moveCount() const { return _move_count; }
+
+		void addMove(TriCoord c) {
+			const std::int64_t index = c.x * 2 + c.y * _board_size * 4 + c.R;
+			putVarint(_moves, zigzag(index - _previous));
+			_previous = index;
+			++_move_count;
+		}
+
+		//Appends the record, length first
+		void encode(std::string& out) const {
+			thread_local std::string body;
+			body.clear();
+			putVarint(body, static_cast<std::uint64_t>(_board_size));
+			putVarint(body, winner ? static_cast<std::uint64_t>(*winner) + 1 : 0);
+			putVarint(body, game);
+			putVarint(body, players.size());
+			for (auto& p : players) {
+				putVarint(body, p.strategy.size());
+				body += p.strategy;
+				putVarint(body, p.seed);
+			}
+			putVarint(body, _move_count);
+			body += _moves;
+			putVarint(out, body.size());
+			out += body;
+		}
+	};
+
+	//Writes records to a stream as games finish
+	class Writer {
+		std::ostream& _out;
+		std::string _buffer;
+
+	public:
+		//Starts a new file unless appending to one that already has its header
+		explicit Writer(std::ostream& out, bool write_header = true) : _out(out) {
+			if (write_header) {
+				_out.write(file_magic.data(), file_magic.size());
+				_out.put(static_cast<char>(file_version));
+			}
+		}
+
+		void write(const GameRecord& record) {
+			_buffer.clear();
+			record.encode(_buffer);
+			_out.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+		}
+
+		void flush() {
+			_out.flush();
+		}
+	};
+
+	//A record in the reader's buffer, decoded only as far as its header
+	class RecordView {
+		std::array<std::string_view, max_players> _strategies;
+		std::array<std::uint64_t, max_players> _seeds{};
+		const std::uint8_t* _moves = nullptr;
+		const std::uint8_t* _end = nullptr;
+
+		friend class Reader;
+
+	public:
+		int board_size = 0;
+		std::optional<int> winner;
+		std::uint64_t game = 0;
+		int players = 0;
+		std::uint64_t move_count = 0;
+
+		std::string_view strategy(int player) const { return _strategies[player]; }
+		std::uint64_t seed(int player) const { return _seeds[player]; }
+
+		//f(TriCoord) for every move in order, decoded on the fly. False if the moves are cut short.
+		template<typename F>
+		bool forEachMove(F f) const {
+			ByteReader in(_moves, _end);
+			std::int64_t index = 0;
+			const int row = board_size * 4;
+			for (std::uint64_t i = 0; i < move_count; ++i) {
+				index += unzigzag(in.varint());
+				if (!in.ok() || index < 0) return false;
+				f(TriCoord{ static_cast<int>(index % row) / 2, static_cast<int>(index / row), static_cast<bool>(index % 2) });
+			}
+			return true;
+		}
+	};
+
+	//Walks the records of a file's bytes, usually a MappedFile, without copying them
+	class Reader {
+		ByteReader _in;
+		bool _failed = false;
+
+		Reader(const std::uint8_t* begin, const std::uint8_t* end) : _in(begin, end) {}
+
+	public:
+		//Nothing if the bytes don't start with a header of this version
+		static std::optional<Reader> open(std::span<const std::byte> data) {
+			const auto* begin = reinterpret_cast<const std::uint8_t*>(data.data());
+			if (data.size() < file_magic.size() + 1 || std::memcmp(begin, file_magic.data(), file_magic.size()) != 0 || begin[file_magic.size()] != file_version) return {};
+			return Reader(begin + file_magic.size() + 1, begin + data.size());
+		}
+
+		//The next record, nothing at the end of the data or at a broken record
+		std::optional<RecordView> next() {
+			if (_failed || _in.position() == _in.end()) return {};
+			const auto length = _in.varint();
+			auto body = _in.bytes(static_cast<std::size_t>(length));
+			if (!_in.ok()) {
+				_failed = true;
+				return {};
+			}
+			const auto* begin = reinterpret_cast<const std::uint8_t*>(body.data());
+			ByteReader in(begin, begin + body.size());
+			RecordView r;
+			r.board_size = static_cast<int>(in.varint());
+			if (auto w = in.varint(); w != 0) r.winner = static_cast<int>(w - 1);
+			r.game = in.varint();
+			r.players = static_cast<int>(in.varint());
+			if (r.players > max_players) {
+				_failed = true;
+				return {};
+			}
+			for (int p = 0; p < r.players; ++p) {
+				r._strategies[p] = in.bytes(static_cast<std::size_t>(in.varint()));
+				r._seeds[p] = in.varint();
+			}
+			r.move_count = in.varint();
+			if (!in.ok() || r.board_size <= 0) {
+				_failed = true;
+				return {};
+			}
+			r._moves = in.position();
+			r._end = in.end();
+			return r;
+		}
+
+		//Whether reading stopped at a broken record instead of the end
+		bool failed() const { return _failed; }
+	};
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <optional>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//A whole file mapped into memory. Pages are only read from disk when they're touched, so a
+//big table can be probed here and there without ever being loaded as a whole.
+class MappedFile {
+	std::byte* _data = nullptr;
+	std::size_t _size = 0;
+#ifdef _WIN32
+	HANDLE _file = INVALID_HANDLE_VALUE;
+	HANDLE _mapping = nullptr;
+#else
+	int _fd = -1;
+#endif
+
+	void close() {
+#ifdef _WIN32
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+		_mapping = nullptr;
+		_file = INVALID_HANDLE_VALUE;
+#else
+		if (_data) munmap(_data, _size);
+		if (_fd >= 0) ::close(_fd);
+		_fd = -1;
+#endif
+		_data = nullptr;
+		_size = 0;
+	}
+
+	//size 0 opens the file as it is, read only. Otherwise it gets created or resized to size and mapped writable.
+	bool map(const std::string& path, std::size_t size) {
+		const bool writable = size != 0;
+#ifdef _WIN32
+		_file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+			writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (_file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER file_size;
+		if (writable) {
+			file_size.QuadPart = static_cast<LONGLONG>(size);
+			if (!SetFilePointerEx(_file, file_size, nullptr, FILE_BEGIN) || !SetEndOfFile(_file)) return false;
+		}
+		else if (!GetFileSizeEx(_file, &file_size) || file_size.QuadPart == 0) return false;
+		_size = static_cast<std::size_t>(file_size.QuadPart);
+		_mapping = CreateFileMappingA(_file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+		if (!_mapping) return false;
+		_data = static_cast<std::byte*>(MapViewOfFile(_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+		return _data != nullptr;
+#else
+		_fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+		if (_fd < 0) return false;
+		if (writable) {
+			if (ftruncate(_fd, static_cast<off_t>(size)) != 0) return false;
+			_size = size;
+		}
+		else {
+			struct stat info;
+			if (fstat(_fd, &info) != 0 || info.st_size == 0) return false;
+			_size = static_cast<std::size_t>(info.st_size);
+		}
+		void* data = mmap(nullptr, _size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _fd, 0);
+		if (data == MAP_FAILED) return false;
+		_data = static_cast<std::byte*>(data);
+		return true;
+#endif
+	}
+
+public:
+	MappedFile() = default;
+
+	MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			close();
+			std::swap(_data, other._data);
+			std::swap(_size, other._size);
+#ifdef _WIN32
+			std::swap(_file, other._file);
+			std::swap(_mapping, other._mapping);
+#else
+			std::swap(_fd, other._fd);
+#endif
+		}
+		return *this;
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	static std::optional<MappedFile> openReadOnly(const std::string& path) {
+		MappedFile ret;
+		if (!ret.map(path, 0)) return {};
+		return ret;
+	}
+
+	//Creates the file or resizes an existing one, new bytes read as zero
+	static std::optional<MappedFile> openWritable(const std::string& path, std::size_t size) {
+		MappedFile ret;
+		if (size == 0 || !ret.map(path, size)) return {};
+		return ret;
+	}
+
+	std::byte* data() { return _data; }
+	const std::byte* data() const { return _data; }
+	std::size_t size() const { return _size; }
+};
+
+//Exclusive lock on a file shared between processes, held until it's destroyed.
+//Only keeps out others that take the same lock, it's meant for a side file like table.bin.lock.
+class FileLock {
+#ifdef _WIN32
+	HANDLE _file = INVALID_HANDLE_VALUE;
+#else
+	int _fd = -1;
+#endif
+
+	FileLock() = default;
+
+public:
+	FileLock(FileLock&& other) noexcept {
+#ifdef _WIN32
+		std::swap(_file, other._file);
+#else
+		std::swap(_fd, other._fd);
+#endif
+	}
+
+	FileLock& operator=(FileLock&&) = delete;
+
+	~FileLock() {
+#ifdef _WIN32
+		if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file); //closing releases the lock
+#else
+		if (_fd >= 0) ::close(_fd);
+#endif
+	}
+
+	//Waits for the lock, creating the file if it doesn't exist
+	static std::optional<FileLock> exclusive(const std::string& path) {
+		FileLock ret;
+#ifdef _WIN32
+		ret._file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (ret._file == INVALID_HANDLE_VALUE) return {};
+		OVERLAPPED overlapped{};
+		if (!LockFileEx(ret._file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped)) return {};
+#else
+		ret._fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (ret._fd < 0 || flock(ret._fd, LOCK_EX) != 0) return {};
+#endif
+		return ret;
+	}
+};
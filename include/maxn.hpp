@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <stop_token>
+#include "board.hpp"
+#include "chains.hpp"
+#include "search.hpp"
+
+//Game tree search for games with more than two players
+namespace search {
+
+	constexpr int max_players = 5; //as many as the player select screen allows
+	constexpr int maxn_total = 1000;
+
+	//Every player's share of a position, they never add up to more than maxn_total
+	using Shares = std::array<int, max_players>;
+
+	//Shares in proportion to the players' chain scores, eliminated players get nothing
+	Shares evaluateShares(const Board& b, int num_players) {
+		thread_local ChainEvaluator chains;
+		std::array<int, max_players> weight{};
+		int sum = 0;
+		for (int p = 0; p < num_players; ++p) {
+			if (b.isEliminated(p)) continue;
+			chains.rebase(b, p);
+			weight[p] = std::max(chains.score(), 1);
+			sum += weight[p];
+		}
+		Shares shares{};
+		for (int p = 0; p < num_players; ++p) shares[p] = weight[p] * maxn_total / sum;
+		return shares;
+	}
+
+	Shares wonShares(int winner) {
+		Shares shares{};
+		shares[winner] = maxn_total;
+		return shares;
+	}
+
+	//Explosions that never stop split the game between everyone left in it
+	Shares drawnShares(const Board& b, int num_players) {
+		Shares shares{};
+		int left = 0;
+		for (int p = 0; p < num_players; ++p) left += !b.isEliminated(p);
+		for (int p = 0; p < num_players; ++p) shares[p] = b.isEliminated(p) ? 0 : maxn_total / left;
+		return shares;
+	}
+
+	namespace detail {
+		//Every player picks the move that's best for themselves. Because shares add up to at most maxn_total,
+		//once a player has found a move worth bound to them the player before can't get more than it already has
+		//out of this position, and the rest of the moves are skipped (shallow pruning).
+		//A stop ends the search before the next move, what it returns then is meaningless.
+		Shares maxN(const Board& b, int player, int num_players, int depth, int bound, const std::stop_token& stop = {}) {
+			if (depth == 0) return evaluateShares(b, num_players);
+
+			std::vector<TriCoord> moves;
+			legalMoves(b, player, moves);
+			if (moves.empty()) return evaluateShares(b, num_players);
+			Shares best{};
+			best[player] = -1;
+			for (auto c : moves) {
+				if (stop.stop_requested()) break;
+				Board child = b;
+				Shares value;
+				switch (playMove(child, c, player)) {
+				case MoveEnd::Won:
+					return wonShares(player);
+				case MoveEnd::Endless:
+					value = drawnShares(child, num_players);
+					break;
+				default:
+					value = maxN(child, nextActivePlayer(child, player, num_players), num_players, depth - 1, maxn_total - best[player], stop);
+				}
+				if (value[player] > best[player]) best = value;
+				if (best[player] >= bound) break;
+			}
+			return best;
+		}
+	}
+
+	//Fixed depth max-n search, depth counts the moves of all players. Eliminated players are skipped.
+	//The score of the result is the share the move gets the player.
+	Result maxN(const Board& b, int player, int num_players, int depth) {
+		std::vector<TriCoord> moves;
+		legalMoves(b, player, moves);
+		Result best{ {}, -1 };
+		for (auto c : moves) {
+			Board child = b;
+			int score;
+			switch (playMove(child, c, player)) {
+			case MoveEnd::Won:
+				return { c, maxn_total };
+			case MoveEnd::Endless:
+				score = drawnShares(child, num_players)[player];
+				break;
+			default:
+				score = detail::maxN(child, nextActivePlayer(child, player, num_players), num_players, depth - 1, maxn_total - best.score)[player];
+			}
+			if (score > best.score) best = { c, score };
+		}
+		return best;
+	}
+}
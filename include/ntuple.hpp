@@ -0,0 +1,238 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "board.hpp"
+#include "random.hpp"
+
+//Learned evaluation: every tile together with its three neighbors forms a small pattern (an N-tuple),
+//each possible pattern has a weight and a board's value is the sum of the weights of all its patterns.
+//
+//Tiles are encoded from the evaluating player's point of view as empty, 1 or 2 own pieces or 1 or 2 enemy pieces.
+//Neighbors can also be out of bounds and additionally note whether they are one piece away from exploding.
+//The middle tile's part of the index says whether it points up and is an edge tile, which covers that for it.
+class NTupleNetwork {
+	static constexpr int center_states = 5;
+	static constexpr int neighbor_states = 10;
+	static constexpr std::array<char, 4> file_magic = { 'E','T','N','T' };
+	static constexpr std::uint32_t file_version = 2;
+
+	//Pattern index of every tile without its own state, and where its neighbors are. Only depends on the board size.
+	struct Geometry {
+		int size = -1;
+		std::vector<int> tiles;
+		std::vector<int> base;
+		std::vector<std::array<int, 3>> neighbors; //-1 for out of bounds
+		std::vector<int> allowed;
+	};
+
+	static const Geometry& geometry(const Board& b) {
+		thread_local Geometry g;
+		if (g.size != b.size()) {
+			g = Geometry{};
+			g.size = b.size();
+			g.allowed.assign(b.tiles().size(), 0);
+			b.iterTiles([&](TriCoord c) {
+				int i = static_cast<int>(b.index(c));
+				g.tiles.push_back(i);
+				g.base.push_back((c.R * 2 + b.isEdge(c)) * center_states);
+				g.allowed[i] = b.allowedPieces(c);
+				auto& n = g.neighbors.emplace_back();
+				std::ranges::transform(c.neighbors(), n.begin(), [&](TriCoord n) {return b.inBounds(n) ? static_cast<int>(b.index(n)) : -1; });
+				return true;
+			});
+		}
+		return g;
+	}
+
+	//0 empty, 1-2 own pieces, 3-4 enemy pieces
+	static int encodeCenter(TileState s, int player) {
+		if (s.num == 0) return 0;
+		return (s.player == player ? 0 : 2) + std::min(s.num, 2);
+	}
+
+	//0 out of bounds, 1 empty, 2-5 own pieces, 6-9 enemy pieces: 1 or 2 pieces, each either safe or about to explode
+	static int encodeNeighbor(TileState s, int allowed, int player) {
+		if (s.num == 0) return 1;
+		return (s.player == player ? 2 : 6) + (std::min(s.num, 2) - 1) * 2 + (s.num >= allowed);
+	}
+
+public:
+	static constexpr std::size_t num_weights = 2 * 2 * center_states * neighbor_states * neighbor_states * neighbor_states;
+
+	std::vector<float> weights = std::vector<float>(num_weights, 0.f);
+
+	//Calls f with the weight index of every pattern on the board
+	template<typename F>
+	static void forEachPattern(const Board& b, int player, F f) {
+		const Geometry& g = geometry(b);
+		auto tiles = b.tiles();
+		for (std::size_t t = 0; t < g.tiles.size(); ++t) {
+			std::size_t i = g.base[t] + encodeCenter(tiles[g.tiles[t]], player);
+			for (int n : g.neighbors[t]) {
+				i = i * neighbor_states + (n < 0 ? 0 : encodeNeighbor(tiles[n], g.allowed[n], player));
+			}
+			f(i);
+		}
+	}
+
+	float evaluate(const Board& b, int player) const {
+		float sum = 0;
+		forEachPattern(b, player, [&](std::size_t i) {sum += weights[i]; });
+		return sum;
+	}
+
+	//File layout: "ETNT", version and weight count as uint32, then the weights as floats, all in the machine's byte order
+	bool save(const std::string& path) const {
+		std::ofstream out(path, std::ios::binary);
+		const std::uint32_t header[2] = { file_version, static_cast<std::uint32_t>(weights.size()) };
+		out.write(file_magic.data(), file_magic.size());
+		out.write(reinterpret_cast<const char*>(header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(weights.data()), weights.size() * sizeof(float));
+		return static_cast<bool>(out);
+	}
+
+	static std::optional<NTupleNetwork> load(const std::string& path) {
+		std::ifstream in(path, std::ios::binary);
+		std::array<char, 4> magic{};
+		std::uint32_t header[2]{};
+		in.read(magic.data(), magic.size());
+		in.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (!in || magic != file_magic || header[0] != file_version || header[1] != num_weights) return {};
+
+		NTupleNetwork ret;
+		in.read(reinterpret_cast<char*>(ret.weights.data()), ret.weights.size() * sizeof(float));
+		if (!in) return {};
+		return ret;
+	}
+};
+
+//Learns NTupleNetwork weights by temporal difference learning over self-play games.
+//
+//Both sides pick the move whose resulting position the network likes best (or a random one with
+//probability exploration) and every position a player moves into is pulled towards the value of the next
+//one it moves into, or towards +1/-1 once the game is decided. Values are squashed with tanh to stay in that range.
+//
+//Worker threads play batches of games against a copy of the weights and add their summed updates to the shared network in between.
+class NTupleTrainer {
+	NTupleNetwork& net;
+	std::mutex net_mutex;
+
+	struct Previous {
+		std::vector<std::size_t> patterns;
+		float value = 0;
+		bool valid = false;
+	};
+
+	void learn(Previous& prev, float target, std::vector<float>& delta) const {
+		if (!prev.valid) return;
+		const float step = learning_rate * (target - prev.value) * (1 - prev.value * prev.value);
+		for (auto i : prev.patterns) delta[i] += step;
+	}
+
+	void playGame(const NTupleNetwork& current, std::vector<float>& delta, RandomStream& random) const {
+		Board b(board_size), test;
+		std::array<Previous, 2> prev;
+		Previous next;
+		std::vector<TriCoord> moves;
+		int player = 0;
+
+		for (int turn = 0; turn < max_turns; ++turn) {
+			moves.clear();
+			b.iterTiles([&](TriCoord c) {
+				if (b[c].player == player || b[c].num == 0) moves.push_back(c);
+				return true;
+			});
+
+			auto play = [&](Board& board, TriCoord m) {
+				board.incTile(m, player);
+				while (board.needsUpdate() && !board.isWon()) board.update_step();
+			};
+
+			TriCoord chosen = moves[random.below(static_cast<std::uint32_t>(moves.size()))];
+			if (random.uniform() >= exploration) {
+				float best = -std::numeric_limits<float>::infinity();
+				for (auto m : moves) {
+					test = b;
+					play(test, m);
+					float val = test.isWon() ? std::numeric_limits<float>::infinity() : current.evaluate(test, player);
+					if (val > best) {
+						best = val;
+						chosen = m;
+					}
+				}
+			}
+			play(b, chosen);
+
+			if (b.isWon()) {
+				learn(prev[player], 1, delta);
+				learn(prev[1 - player], -1, delta);
+				return;
+			}
+
+			next.patterns.clear();
+			NTupleNetwork::forEachPattern(b, player, [&](std::size_t i) {next.patterns.push_back(i); });
+			next.value = std::tanh(current.evaluate(b, player));
+			next.valid = true;
+			learn(prev[player], next.value, delta);
+			std::swap(prev[player], next);
+			player = 1 - player;
+		}
+	}
+
+public:
+	int board_size = 3;
+	float learning_rate = 0.002f;
+	float exploration = 0.1f;
+	int max_turns = 1000;
+	int batch_size = 16;
+
+	NTupleTrainer(NTupleNetwork& net) : net(net) {}
+
+	//Plays games on num_threads threads, on_progress(games done) is called after every batch with the network locked
+	void train(int games, int num_threads, std::uint64_t seed, auto on_progress) {
+		std::atomic<int> next_batch = 0;
+		int games_done = 0;
+		const int num_batches = (games + batch_size - 1) / batch_size;
+
+		auto worker = [&](int thread_num) {
+			RandomStream random(seed, thread_num);
+			NTupleNetwork current;
+			std::vector<float> delta(NTupleNetwork::num_weights);
+			for (int batch = next_batch++; batch < num_batches; batch = next_batch++) {
+				{
+					std::scoped_lock lock(net_mutex);
+					current.weights = net.weights;
+				}
+				const int batch_games = std::min(batch_size, games - batch * batch_size);
+				for (int g = 0; g < batch_games; ++g) {
+					playGame(current, delta, random);
+				}
+
+				std::scoped_lock lock(net_mutex);
+				for (std::size_t i = 0; i < delta.size(); ++i) {
+					net.weights[i] += delta[i];
+				}
+				std::ranges::fill(delta, 0.f);
+				games_done += batch_games;
+				on_progress(games_done);
+			}
+		};
+
+		std::vector<std::jthread> threads;
+		for (int t = 1; t < num_threads; ++t) {
+			threads.emplace_back(worker, t);
+		}
+		worker(0);
+	}
+};
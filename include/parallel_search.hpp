@@ -0,0 +1,262 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <stop_token>
+#include "board.hpp"
+#include "symmetry.hpp"
+#include "search.hpp"
+#include "transposition.hpp"
+
+namespace search {
+
+	//Alpha-beta on every core at once, lazy SMP style: all threads search the same position with iterative deepening
+	//and only talk to each other through the shared transposition table. Helper threads start one ply deeper
+	//every other thread and try the moves in different orders, so they fill in the table ahead of the main thread
+	//instead of repeating its work. The move is always the main thread's.
+	//
+	//Positions are stored under their canonical hash, so symmetric positions share entries.
+	//Results persist between searches, a search usually starts with most of its tree from the last move in the table.
+	//With a table_file they persist between runs too: the saved table is probed alongside the search's own one,
+	//and what the search found gets merged into it by save(), which the owner calls once it's done searching.
+	//Merging takes the file lock and walks the whole table, so it's not done for every search or game.
+	//The saved scores come from search::evaluate, a file has to be thrown away when that changes.
+	//
+	//A search can be cut short from another thread through the stop token it's given, it then returns the move of the
+	//deepest depth it finished. Every thread looks at the token every 256 nodes.
+	class ParallelSearch {
+	public:
+		struct Settings {
+			int threads = 1;
+			int max_depth = 32; //at most TranspositionTable::max_depth, deeper limits are cut down to it
+			std::chrono::milliseconds time_limit{ 300 }; //0 searches all depths up to max_depth, which can take ages on big boards
+			long long node_limit = 0; //nodes of all threads together, 0 for no limit
+			bool until_stopped = false; //keeps going past max_depth and decided scores until the stop token or a limit ends it
+			std::size_t table_bytes = std::size_t(1) << 20; //enough for short searches, callers that search for longer give it more
+			std::string table_file{}; //saved table to start from and merge into afterwards, none if empty
+		};
+
+		//After every depth the main thread finishes
+		struct Info {
+			int depth;
+			Result best;
+			long long nodes;
+			std::chrono::nanoseconds elapsed;
+		};
+
+	private:
+		struct Worker {
+			int id;
+			long long nodes = 0;
+		};
+
+		Settings _settings;
+		TranspositionTable _table;
+		std::optional<TranspositionTable> _saved; //read only
+		std::optional<BoardSymmetries> _symmetries;
+		std::atomic<bool> _stop = false;
+		std::atomic<long long> _nodes = 0;
+		std::stop_token _stop_token;
+		std::chrono::steady_clock::time_point _deadline;
+		std::function<void(const Info&)> _on_depth;
+
+		static constexpr int mate_range = 10000; //scores this close to win_score are wins, stored relative to the position
+
+		static int toTable(int score, int ply) {
+			return score > win_score - mate_range ? score + ply : score < -win_score + mate_range ? score - ply : score;
+		}
+
+		static int fromTable(int score, int ply) {
+			return score > win_score - mate_range ? score - ply : score < -win_score + mate_range ? score + ply : score;
+		}
+
+		bool stopped(Worker& w) {
+			if ((++w.nodes & 255) == 0) {
+				const long long nodes = _nodes.fetch_add(256, std::memory_order_relaxed) + 256;
+				if (_stop_token.stop_requested() || (_settings.node_limit > 0 && nodes >= _settings.node_limit)
+					//only the main thread watches the clock
+					|| (w.id == 0 && _settings.time_limit.count() > 0 && std::chrono::steady_clock::now() >= _deadline)) {
+					_stop.store(true, std::memory_order_relaxed);
+				}
+			}
+			return _stop.load(std::memory_order_relaxed);
+		}
+
+		//Moves with the table's best move first, helpers rotate the rest so each of them starts in a different place
+		void orderMoves(Worker& w, const Board& b, int player, const BoardSymmetries::Canonical& canonical, std::optional<TranspositionTable::Entry> entry, std::vector<TriCoord>& moves) {
+			legalMoves(b, player, moves);
+			auto rest = moves.begin();
+			if (entry && entry->move >= 0) {
+				auto best = std::ranges::find(moves, _symmetries->tile(_symmetries->image(canonical.symmetry, entry->move)));
+				if (best != moves.end()) {
+					std::iter_swap(moves.begin(), best);
+					++rest;
+				}
+			}
+			if (w.id != 0 && rest != moves.end()) {
+				std::rotate(rest, rest + (w.id * 7) % (moves.end() - rest), moves.end());
+			}
+		}
+
+		//The deeper of this run's entry and the saved one
+		std::optional<TranspositionTable::Entry> probe(std::uint64_t hash) const {
+			auto entry = _table.probe(hash);
+			if (_saved) {
+				auto saved = _saved->probe(hash);
+				if (saved && (!entry || saved->depth > entry->depth)) return saved;
+			}
+			return entry;
+		}
+
+		void store(const BoardSymmetries::Canonical& canonical, int score, int depth, int ply, TranspositionTable::Bound bound, std::optional<TriCoord> move) {
+			const int tile = move ? _symmetries->preimage(canonical.symmetry, _symmetries->tileNumber(*move)) : -1;
+			_table.store(canonical.hash, { toTable(score, ply), depth, bound, tile });
+		}
+
+		int alphaBeta(Worker& w, const Board& b, int player, int depth, int ply, int alpha, int beta) {
+			if (stopped(w)) return 0;
+			if (depth == 0) return evaluate(b, player);
+
+			const auto canonical = _symmetries->canonicalHash(b, player);
+			const auto entry = probe(canonical.hash);
+			if (entry && entry->depth >= depth) {
+				const int score = fromTable(entry->score, ply);
+				if (entry->bound == TranspositionTable::Bound::Exact
+					|| (entry->bound == TranspositionTable::Bound::Lower && score >= beta)
+					|| (entry->bound == TranspositionTable::Bound::Upper && score <= alpha)) return score;
+			}
+
+			std::vector<TriCoord> moves;
+			orderMoves(w, b, player, canonical, entry, moves);
+			if (moves.empty()) return -win_score + ply;
+			const int start_alpha = alpha;
+			std::optional<TriCoord> best;
+			for (auto c : moves) {
+				Board child = b;
+				int score;
+				switch (playMove(child, c, player)) {
+				case MoveEnd::Won:
+					score = win_score - ply - 1;
+					break;
+				case MoveEnd::Endless:
+					score = 0;
+					break;
+				default:
+					score = -alphaBeta(w, child, 1 - player, depth - 1, ply + 1, -beta, -alpha);
+				}
+				if (score > alpha) {
+					alpha = score;
+					best = c;
+				}
+				if (alpha >= beta) break;
+			}
+			if (_stop.load(std::memory_order_relaxed)) return 0; //cut short, the score means nothing
+
+			const auto bound = alpha >= beta ? TranspositionTable::Bound::Lower : alpha > start_alpha ? TranspositionTable::Bound::Exact : TranspositionTable::Bound::Upper;
+			store(canonical, alpha, depth, ply, bound, best);
+			return alpha;
+		}
+
+		//Nothing if the search was stopped before it finished the depth
+		std::optional<Result> searchRoot(Worker& w, const Board& b, int player, int depth) {
+			const auto canonical = _symmetries->canonicalHash(b, player);
+			std::vector<TriCoord> moves;
+			orderMoves(w, b, player, canonical, probe(canonical.hash), moves);
+			Result best{ {}, std::numeric_limits<int>::min() };
+			for (auto c : moves) {
+				Board child = b;
+				int score;
+				switch (playMove(child, c, player)) {
+				case MoveEnd::Won:
+					return Result{ c, win_score - 1 };
+				case MoveEnd::Endless:
+					score = 0;
+					break;
+				default:
+					score = -alphaBeta(w, child, 1 - player, depth - 1, 1, -win_score, best.move ? -best.score : win_score);
+				}
+				if (_stop.load(std::memory_order_relaxed)) return {};
+				if (score > best.score) best = { c, score };
+			}
+			if (best.move) store(canonical, best.score, depth, 0, TranspositionTable::Bound::Exact, best.move);
+			return best;
+		}
+
+	public:
+		explicit ParallelSearch(const Settings& settings) : _settings(settings), _table(settings.table_bytes) {
+			_settings.max_depth = std::clamp(_settings.max_depth, 1, TranspositionTable::max_depth);
+		}
+
+		ParallelSearch(const ParallelSearch&) = delete;
+
+		//Merges what was searched so far into the table file, if there is one. Searches on a board of another size do it by themselves.
+		bool save() const {
+			if (_settings.table_file.empty() || !_symmetries) return false;
+			return _table.mergeInto(_settings.table_file, _symmetries->size());
+		}
+
+		//Changes the limits for the next searches
+		void setLimits(int max_depth, std::chrono::milliseconds time_limit, long long node_limit, bool until_stopped = false) {
+			_settings.max_depth = std::clamp(max_depth, 1, TranspositionTable::max_depth);
+			_settings.time_limit = time_limit;
+			_settings.node_limit = node_limit;
+			_settings.until_stopped = until_stopped;
+		}
+
+		//Called from the searching thread
+		void setInfoListener(std::function<void(const Info&)> f) {
+			_on_depth = std::move(f);
+		}
+
+		//Nodes searched by the last search
+		long long nodes() const {
+			return _nodes.load(std::memory_order_relaxed);
+		}
+
+		//Two player positions only
+		Result search(const Board& b, int player, std::stop_token stop = {}) {
+			if (!_symmetries || _symmetries->size() != b.size()) {
+				save();
+				_symmetries.emplace(b.size());
+				_table.clear();
+				if (!_settings.table_file.empty()) _saved = TranspositionTable::open(_settings.table_file, b.size());
+			}
+			_stop = false;
+			_nodes = 0;
+			_stop_token = stop;
+			const auto start = std::chrono::steady_clock::now();
+			_deadline = start + _settings.time_limit;
+
+			Result best{ {}, 0 };
+			auto work = [&](int id) {
+				Worker w{ id };
+				//until_stopped goes on to the deepest depth the table can hold, then waits for the stop like a finished search
+				const int last = _settings.until_stopped ? TranspositionTable::max_depth : _settings.max_depth;
+				for (int depth = 1 + id % 2; depth <= last && !_stop.load(std::memory_order_relaxed); ++depth) {
+					auto result = searchRoot(w, b, player, depth);
+					if (!result) break;
+					if (id != 0) continue;
+					best = *result;
+					if (_on_depth) _on_depth({ depth, best, _nodes.load(std::memory_order_relaxed) + (w.nodes & 255), std::chrono::steady_clock::now() - start });
+					//decided games don't get any more decided by searching deeper
+					if (std::abs(best.score) > win_score - mate_range && !_settings.until_stopped) break;
+				}
+				_nodes.fetch_add(w.nodes & 255, std::memory_order_relaxed);
+				if (id == 0) _stop = true;
+			};
+			{
+				std::vector<std::jthread> helpers;
+				for (int t = 1; t < _settings.threads; ++t) helpers.emplace_back(work, t);
+				work(0);
+			}
+			return best;
+		}
+	};
+}
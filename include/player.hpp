@@ -2,14 +2,24 @@
 
 #include <random>
 #include <tuple>
+#include <utility>
 #include <span>
 #include <concepts>
 #include <optional>
 #include <functional>
 #include <variant>
 #include <ranges>
-#include <SFML/System/Clock.hpp>
+#include <memory>
+#include <chrono>
 #include "board.hpp"
+#include "random.hpp"
+#include "chains.hpp"
+#include "features.hpp"
+#include "ntuple.hpp"
+#include "tablebase.hpp"
+#include "book.hpp"
+#include "maxn.hpp"
+#include "parallel_search.hpp"
 
 template<class... Ts> struct overloaded : Ts... { using Ts::operator()...; };
 template<class... Ts> overloaded(Ts...)->overloaded<Ts...>;
@@ -73,18 +83,23 @@ namespace AI {
 	template<typename F>
 	concept AIFunc = std::is_invocable_r_v<std::optional<TriCoord>,F, const Board&, std::span<TriCoord>, int>;
 	
+	//Strategy is normally the concrete composed lambda so every stage can be inlined into the turn,
+	//AIPlayer<AIFunction> is the type-erased version for strategies only known at runtime
+	template<AIFunc Strategy = AIFunction>
 	class AIPlayer : public Player {
-		AIFunction f;
+		Strategy f;
 		TriCoord chosen{};
+		std::vector<TriCoord> allowed_moves; //kept around so its capacity is reused every turn
 	public:
-		AIPlayer(AIFunction strat) : f(std::move(strat)) {}
+		AIPlayer(Strategy strat) : f(std::move(strat)) {}
 		void startTurn(const Board& b, int player_num) override {
-			std::vector<TriCoord> allowed_moves;
+			allowed_moves.clear();
 			b.iterTiles([&](TriCoord c) {
 				if (b[c].player == player_num || b[c].num == 0) allowed_moves.push_back(c);
 				return true;
 			});
-			chosen = *f(b, allowed_moves, player_num);
+			std::optional<TriCoord> choice = f(b, allowed_moves, player_num); //strategies may return a plain TriCoord
+			chosen = *choice;
 		}
 		TriCoord selected() const override {
 			//TODO: return 0 if haven't received result yet
@@ -95,27 +110,40 @@ namespace AI {
 		}
 	};
 
+	using DynamicAIPlayer = AIPlayer<AIFunction>;
+
+	template<AIFunc Strategy = AIFunction>
 	class InteractiveAIPlayer : public Player {
-		static constexpr float interact_time = 0.3f;
-		AIPlayer p;
-		sf::Clock timer{};
+		static constexpr std::chrono::milliseconds interact_time{ 300 };
+		AIPlayer<Strategy> p;
+		std::chrono::steady_clock::time_point turn_start{};
 	public:
-		InteractiveAIPlayer(AIPlayer player) : p{ std::move(player) } {}
+		InteractiveAIPlayer(AIPlayer<Strategy> player) : p{ std::move(player) } {}
 		void startTurn(const Board& b, int player_num) override {
 			p.startTurn(b,player_num);
-			timer.restart();
+			turn_start = std::chrono::steady_clock::now();
 		}
 		TriCoord selected() const override {
 			return p.selected();
 		}
 		std::optional<TriCoord> update() override {
-			if (timer.getElapsedTime().asSeconds() >= interact_time) {
+			if (std::chrono::steady_clock::now() - turn_start >= interact_time) {
 				return p.update();
 			}
 			return {};
 		}
 	};
 
+	template<AIFunc Strategy>
+	std::unique_ptr<Player> makeAIPlayer(Strategy strat) {
+		return std::make_unique<AIPlayer<Strategy>>(std::move(strat));
+	}
+
+	template<AIFunc Strategy>
+	std::unique_ptr<Player> makeInteractiveAIPlayer(Strategy strat) {
+		return std::make_unique<InteractiveAIPlayer<Strategy>>(AIPlayer<Strategy>(std::move(strat)));
+	}
+
 	
 
 	AIFunc auto firstSuccess(AIFunc auto... strats) {
@@ -126,18 +154,47 @@ namespace AI {
 		};
 	}
 
-	AIFunc auto randomAI(std::default_random_engine& random) {
-		return [engine = &random](const Board&, std::span<TriCoord> moves, int) {
-			return moves[std::uniform_int_distribution(0, static_cast<int>(moves.size() - 1))(*engine)];
+	//Owns its stream, copies of the strategy keep drawing from the same one
+	AIFunc auto randomAI(RandomStream random) {
+		return [engine = std::make_shared<RandomStream>(random)](const Board&, std::span<TriCoord> moves, int) {
+			return moves[engine->below(static_cast<std::uint32_t>(moves.size()))];
 		};
 	}
 
+	//Filters narrow down the moves they are given by swapping the survivors to the front of the span and returning them.
+	//The span stays a reordering of the moves it was given, so a fallback after a filter that kept nothing still sees all of them.
+	template<typename F>
+	concept InPlaceFilter = std::is_invocable_r_v<std::span<TriCoord>, F, const Board&, std::span<TriCoord>, int /*player*/>;
+
+	//Older style filters that return their survivors in a fresh vector, still accepted everywhere a Filter is
+	template<typename F>
+	concept VectorFilter = std::is_invocable_r_v<std::vector<TriCoord>, F, const Board&, std::span<TriCoord>, int /*player*/>;
+
 	template<typename F>
-	concept Filter = std::is_invocable_r_v<std::vector<TriCoord>, F, const Board&, std::span<TriCoord>, int /*player*/>;
+	concept Filter = InPlaceFilter<F> || VectorFilter<F>;
+
+	//Runs a filter on moves, leaving the survivors at the front of moves and returning them
+	std::span<TriCoord> applyFilter(const Filter auto& filter, const Board& b, std::span<TriCoord> moves, int player) {
+		if constexpr (InPlaceFilter<decltype(filter)>) {
+			return filter(b, moves, player);
+		}
+		else {
+			//survivors are a subset of the input, each one is swapped in from where it is
+			auto survivors = filter(b, moves, player);
+			std::size_t out = 0;
+			for (auto c : survivors) {
+				auto rest = moves.subspan(out);
+				auto it = std::ranges::find(rest, c);
+				if (it == rest.end()) continue;
+				std::iter_swap(moves.begin() + out++, it);
+			}
+			return moves.first(out);
+		}
+	}
 
 	AIFunc auto filtered(Filter auto filter, AI::AIFunc auto next) {
 		return [=](const Board& b, std::span<TriCoord> moves, int player)->std::optional<TriCoord> {
-			auto filtered = filter(b, moves, player);
+			auto filtered = applyFilter(filter, b, moves, player);
 			if (filtered.empty()) return {};
 			return next(b, filtered, player);
 		};
@@ -145,49 +202,59 @@ namespace AI {
 
 	Filter auto operator|(Filter auto a, Filter auto b) {
 		return [=](const Board& board, std::span<TriCoord> moves, int player) {
-			auto filtered = a(board, moves, player);
-			return b(board, filtered, player);
+			auto filtered = applyFilter(a, board, moves, player);
+			return applyFilter(b, board, filtered, player);
 		};
 	}
 
 	template<typename F>
 	concept Fitness = std::is_invocable_r_v<int, F, const Board&, int /*player*/, int /*num_updates*/>;
 
+	//Plays out every move and keeps the ones for which evaluate(resulting board, number of explosion waves) is highest
+	std::span<TriCoord> keepBestMoves(const Board& b, std::span<TriCoord> moves, int player, auto evaluate) {
+		//Reused between evaluations so trying out a move doesn't allocate once the buffers have grown
+		thread_local Board test;
+
+		int max = std::numeric_limits<int>::min();
+		std::size_t out = 0;
+		for (std::size_t i = 0; i < moves.size(); ++i) {
+			const auto c = moves[i];
+			test = b;
+			test.trackChanges();
+			test.incTile(c, player);
+			int num = 0;
+			while (test.needsUpdate() && !test.isWon()) {
+				test.update_step();
+				++num;
+			}
+
+			auto val = evaluate(std::as_const(test), num);
+			if (val > max) {
+				out = 0;
+				max = val;
+			}
+			if (val == max) {
+				std::swap(moves[out++], moves[i]);
+			}
+		}
+		return moves.first(out);
+	}
+
 	Filter auto maxFitness(Fitness auto fitness) {
 		return [=](const Board& b, std::span<TriCoord> moves, int player) {
-			auto fitnessEvaluator = [&](TriCoord m) {
-				Board test = b;
-				test.incTile(m, player);
-				int num = 0;
-				while (test.needsUpdate() && !test.isWon()) {
-					test.update_step();
-					++num;
-				}
-
+			return keepBestMoves(b, moves, player, [&](const Board& test, int num) {
 				return fitness(test, player, num);
-			};
-
-			int max = std::numeric_limits<int>::min();
-			std::vector<TriCoord> out;
-			for (auto& c : moves) {
-				auto val = fitnessEvaluator(c);
-				if (val > max) {
-					out.clear();
-					max = val;
-				}
-				if (val == max) {
-					out.push_back(c);
-				}
-			}
-			return out;
+			});
 		};
 	}
 
 	Filter auto filterIncludeMoves(auto pred) {
 		return [=](const Board& b, std::span<TriCoord> moves, int player) {
-			std::vector<TriCoord> filtered_moves;
-			std::ranges::copy_if(moves, std::back_inserter(filtered_moves), [&](auto c) {return pred(b, c, player); });
-			return filtered_moves;
+			std::size_t out = 0;
+			for (std::size_t i = 0; i < moves.size(); ++i) {
+				if (pred(b, moves[i], player)) std::swap(moves[out++], moves[i]);
+			}
+			return moves.first(out);
 		};
 	}
 
@@ -207,118 +274,104 @@ namespace AI {
 		return board.playerTotals()[player];
 	});
 
-	Filter auto heuristic = maxFitness([](const Board& board, int player, int) {
-		if (board.isWon()) return std::numeric_limits<int>::max();
-
-		int count = 0;
-		board.iterTiles([&](TriCoord c) {
-			if (board[c].player == player) {
-				count += board[c].num;
-				std::array<bool, 3> critical;
-				std::ranges::transform(c.neighbors(), critical.begin(), [&](auto n) {return board.inBounds(n) && board[n].player != player && board[n].num == board.allowedPieces(n); });
-				if (std::ranges::any_of(critical, std::identity{})) {
-					//this tile can easily get taken over by the other player's next move
-					count -= 5 + (board[c].num == board.allowedPieces(c)) * 3;
-				}
-				else if (std::ranges::none_of(critical, std::identity{})) {
-					//own a non-threatened tile
-					count += 3;
-					if (board[c].num == board.allowedPieces(c)) {
-						//2 for edge tile, 1 for regular tile
-						count += (3 - board[c].num);
-						//amount of pieces directly threatened
-						count += std::ranges::count_if(c.neighbors(), [&](auto n) {return board.at(n).num; });
-					}
-				}
-			}
-			return true;
-			});
-		return count;
-	});
+	Filter auto weightedHeuristic(HeuristicWeights weights) {
+		return maxFitness([weights](const Board& board, int player, int) {
+			if (board.isWon()) return std::numeric_limits<int>::max();
 
-	Filter auto chains_heuristic = maxFitness([](const Board& board, int player, int) {
-		if (board.isWon()) return std::numeric_limits<int>::max();
+			thread_local BoardFeatures features;
+			features.extract(board, player);
+			return features.heuristicScore(weights);
+		});
+	}
 
-		struct Set {
-			size_t parent;
-			size_t num_owned = 0; //how many of our own pieces are in this set
-			bool threatened = false; //is this set threatened by an enemy explosion next turn?
-			size_t num_threatened_by = 0; //Number of enemy pieces threatened by this set
-		};
+	Filter auto heuristic = weightedHeuristic({});
 
-		auto fill = std::views::iota(0, board.size() * board.size() * 8) | std::views::transform([](size_t i) {return Set{ i }; });
-		std::vector<Set> sets(fill.begin(), fill.end());
+	//The network is used by reference and has to outlive the filter
+	Filter auto ntuple(const NTupleNetwork& net) {
+		return maxFitness([&net](const Board& board, int player, int) {
+			if (board.isWon()) return std::numeric_limits<int>::max();
+			return static_cast<int>(net.evaluate(board, player) * 1000);
+		});
+	}
 
-		auto coord_to_set = [&board](TriCoord c) -> size_t {
-			return c.x * 2 + c.y * board.size() * 4 + c.R;
+	//Perfect play for two player positions in the tablebase: the fastest win, or the slowest loss.
+	//Returns nothing for positions it doesn't know. The table is used by reference and has to outlive the strategy.
+	AIFunc auto tablebase(const Tablebase& table) {
+		return [&table](const Board& b, std::span<TriCoord> moves, int player) -> std::optional<TriCoord> {
+			thread_local Board test;
+			std::optional<TriCoord> best;
+			int best_value = std::numeric_limits<int>::min();
+			for (auto c : moves) {
+				test = b;
+				int value = 0; //draws
+				switch (playMove(test, c, player)) {
+				case MoveEnd::Won:
+					return c;
+				case MoveEnd::Endless:
+					break;
+				case MoveEnd::Continues: {
+					auto e = table.probe(test, 1 - player);
+					if (!e) return {};
+					if (e->result == Tablebase::Result::Loss) value = 1'000'000 - e->distance;
+					else if (e->result == Tablebase::Result::Win) value = -1'000'000 + e->distance;
+					break;
+				}
+				}
+				if (value > best_value) {
+					best_value = value;
+					best = c;
+				}
+			}
+			return best;
 		};
+	}
 
-		auto parent = [&sets](size_t x) -> size_t& {
-			return sets[x].parent;
+	//The book's move while the game is still in it. The book is used by reference and has to outlive the strategy.
+	AIFunc auto book(const OpeningBook& opening_book) {
+		return [&opening_book](const Board& b, std::span<TriCoord> moves, int player) -> std::optional<TriCoord> {
+			auto move = opening_book.probe(b, player);
+			if (!move || std::ranges::find(moves, *move) == moves.end()) return {};
+			return move;
 		};
+	}
 
-		auto find = [&parent](size_t x) {
-			while (parent(x) != x) {
-				parent(x) = parent(parent(x));
-				x = parent(x);
-			}
-			return x;
+	//Max-n search for games of num_players, every player is assumed to play for their own share
+	AIFunc auto maxN(int num_players, int depth) {
+		return [=](const Board& b, std::span<TriCoord> moves, int player) -> std::optional<TriCoord> {
+			auto result = search::maxN(b, player, num_players, depth);
+			if (!result.move || std::ranges::find(moves, *result.move) == moves.end()) return {};
+			return result.move;
 		};
+	}
 
-		auto merge = [&sets, &find](size_t a, size_t b) {
-			a = find(a);
-			b = find(b);
-			if (a == b) return;
-			sets[b].parent = a;
-			sets[a].num_owned += sets[b].num_owned;
-			sets[a].threatened |= sets[b].threatened;
-			sets[a].num_threatened_by += sets[b].num_threatened_by;
+	//Lazy SMP alpha-beta for two player games. Copies of the strategy share one search and its table.
+	AIFunc auto parallelSearch(std::shared_ptr<search::ParallelSearch> searcher) {
+		return [searcher](const Board& b, std::span<TriCoord> moves, int player) -> std::optional<TriCoord> {
+			if (b.playerTotals().size() > 2) return {};
+			auto result = searcher->search(b, player);
+			if (!result.move || std::ranges::find(moves, *result.move) == moves.end()) return {};
+			return result.move;
 		};
+	}
 
-		int count = 0;
-		board.iterTiles([&](TriCoord c) {
-			if (board[c].num == board.allowedPieces(c)) {
-				size_t s = coord_to_set(c);
-				if (board[c].player == player) sets[s].num_owned = board[c].num;
-				else {
-					sets[s].threatened = true;
-				}
-
-				for (auto& neighbor : c.neighbors()) {
-					if (not board.inBounds(neighbor)) continue;
+	AIFunc auto parallelSearch(const search::ParallelSearch::Settings& settings) {
+		return parallelSearch(std::make_shared<search::ParallelSearch>(settings));
+	}
 
-					auto neighbor_set = coord_to_set(neighbor);
-					if (neighbor_set < s) {
-						merge(neighbor_set, s);
-					}
-				}
-			}
-			else if (board[c].num > 0) {
-				bool any_exploding_neighbor = false;
-				bool is_player = board[c].player == player;
-				for (auto& neighbor : c.neighbors()) {
-					if (not board.inBounds(neighbor) || board[neighbor].num != board.allowedPieces(neighbor)) continue;
-					any_exploding_neighbor = true;
-					if (!is_player) {
-						size_t neighbor_set = find(coord_to_set(neighbor));
-						sets[neighbor_set].num_threatened_by += board[c].num;
-					}
-				}
-				if (!any_exploding_neighbor && is_player) count += board[c].num; //Count the piece as a single added thing but not part of any chain
-			}
-			return true;
+	Filter auto weightedChains(HeuristicWeights weights) {
+		return [weights](const Board& b, std::span<TriCoord> moves, int player) {
+			//the chains of the current board are worked out once, each move only redoes the part its explosions touched
+			thread_local ChainEvaluator chains;
+			chains.setWeights(weights);
+			chains.rebase(b, player);
+			return keepBestMoves(b, moves, player, [](const Board& test, int) {
+				if (test.isWon()) return std::numeric_limits<int>::max();
+				return chains.evaluate(test);
 			});
+		};
+	}
 
-		auto all_sets = std::views::iota(size_t{ 0 }, sets.size())
-			| std::views::filter([&](size_t s) {return sets[s].parent == s; });
-
-		for (size_t s : all_sets) {
-			auto& set = sets[s];
-			count += set.threatened ? set.num_owned * -7 : set.num_owned * 3 + set.num_threatened_by * 2;
-		}
-
-		return count;
-	});
+	Filter auto chains_heuristic = weightedChains({});
 }
 
 enum class PlayerType {
@@ -328,26 +381,56 @@ enum class PlayerType {
 	AISmart
 };
 
-std::unique_ptr<Player> toPlayer(PlayerType t) {
-	static std::default_random_engine random_engine(std::random_device{}());
+//Weights from heuristic_weights.txt in the working directory when there is one, as written by AITest tune
+const HeuristicWeights& defaultWeights() {
+	static const HeuristicWeights weights = HeuristicWeights::load("heuristic_weights.txt").value_or(HeuristicWeights{});
+	return weights;
+}
+
+//opening_book.bin in the working directory when there is one, as written by AITest book
+const std::optional<OpeningBook>& defaultBook() {
+	static const std::optional<OpeningBook> book = OpeningBook::open("opening_book.bin");
+	return book;
+}
+
+//AI players make the same choices whenever they're given the same stream
+std::unique_ptr<Player> toPlayer(PlayerType t, RandomStream random, int num_players = 2, const HeuristicWeights& weights = defaultWeights()) {
+	auto random_move = AI::randomAI(random);
 	switch (t)
 	{
 	case PlayerType::Mouse:
 		return std::make_unique<MousePlayer>();
 		break;
 	case PlayerType::AIRando:
-		return std::make_unique<AI::InteractiveAIPlayer>(AI::AIPlayer(AI::randomAI(random_engine)));
+		return AI::makeInteractiveAIPlayer(random_move);
 		break;
 	case PlayerType::AIGreedy:
-		return std::make_unique<AI::InteractiveAIPlayer>(AI::AIPlayer(
-				AI::filtered(AI::maxGain, AI::randomAI(random_engine))
-		));
+		return AI::makeInteractiveAIPlayer(
+				AI::filtered(AI::maxGain, random_move)
+		);
 		break;
 	case PlayerType::AISmart:
-		return std::make_unique<AI::InteractiveAIPlayer>(AI::AIPlayer(
-				AI::filtered(AI::chains_heuristic, AI::randomAI(random_engine))
-		));
+		if (num_players > 2) {
+			return AI::makeInteractiveAIPlayer(AI::firstSuccess(
+				AI::maxN(num_players, 2),
+				random_move
+			));
+		}
+		if (auto& book = defaultBook(); book) {
+			return AI::makeInteractiveAIPlayer(AI::firstSuccess(
+				AI::book(*book),
+				AI::filtered(AI::weightedChains(weights), random_move)
+			));
+		}
+		return AI::makeInteractiveAIPlayer(
+				AI::filtered(AI::weightedChains(weights), random_move)
+		);
 		break;
 	}
 	return nullptr;
 }
+
+std::unique_ptr<Player> toPlayer(PlayerType t, int num_players = 2) {
+	std::random_device seed;
+	return toPlayer(t, RandomStream((std::uint64_t(seed()) << 32) | seed()), num_players);
+}
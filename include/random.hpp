@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <initializer_list>
+
+//xoshiro256** random numbers that can be split into independent streams.
+//
+//A stream is identified by a seed and any number of ids (e.g. game number and player), which are hashed together
+//with splitmix64 into the starting state. Streams depend on nothing else, so a game played with
+//RandomStream(seed, game, player) makes the same choices on whichever thread, process or machine plays it.
+//jump() advances a stream by 2^128 numbers for when non-overlapping sequences are needed from a single seed.
+class RandomStream {
+	std::uint64_t s[4];
+
+	static std::uint64_t rotl(std::uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+
+	static std::uint64_t splitmix64(std::uint64_t& x) {
+		std::uint64_t z = (x += 0x9E3779B97F4A7C15);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+		return z ^ (z >> 31);
+	}
+
+	void seed(std::uint64_t seed, std::initializer_list<std::uint64_t> ids) {
+		std::uint64_t x = seed;
+		for (auto id : ids) {
+			x = splitmix64(x) ^ id;
+		}
+		for (auto& word : s) word = splitmix64(x);
+	}
+
+public:
+	using result_type = std::uint64_t;
+
+	explicit RandomStream(std::uint64_t seed = 0) {
+		this->seed(seed, {});
+	}
+
+	RandomStream(std::uint64_t seed, std::uint64_t stream) {
+		this->seed(seed, { stream });
+	}
+
+	RandomStream(std::uint64_t seed, std::uint64_t stream, std::uint64_t substream) {
+		this->seed(seed, { stream, substream });
+	}
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+	result_type operator()() {
+		const std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+		const std::uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	//Uniform number in [0, n) for n below 2^32, by multiply and shift instead of the standard distributions
+	//so the same stream gives the same choices with every standard library. The bias is below n/2^32.
+	std::uint32_t below(std::uint32_t n) {
+		return static_cast<std::uint32_t>(((*this)() >> 32) * n >> 32);
+	}
+
+	//Uniform in [0, 1)
+	double uniform() {
+		return ((*this)() >> 11) * 0x1.0p-53;
+	}
+
+	void jump() {
+		static constexpr std::uint64_t jump_words[] = { 0x180EC6D33CFD0ABA, 0xD5A61266F0C9392C, 0xA9582618E03FC9AA, 0x39ABDC4529B1661C };
+		std::uint64_t t[4] = {};
+		for (auto word : jump_words) {
+			for (int b = 0; b < 64; ++b) {
+				if (word & (std::uint64_t(1) << b)) {
+					for (int i = 0; i < 4; ++i) t[i] ^= s[i];
+				}
+				(*this)();
+			}
+		}
+		for (int i = 0; i < 4; ++i) s[i] = t[i];
+	}
+};
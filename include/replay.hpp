@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include "board.hpp"
+#include "game_record.hpp"
+#include "snapshot.hpp"
+
+namespace records {
+
+	//A finished game that can be looked at after any of its moves without playing it again from the start.
+	//
+	//Building one plays the game through once, working out who made every move, and keeps a keyframe of the board every
+	//interval moves. seek() restores the closest keyframe before the move and plays the few moves after it, so it never
+	//plays more than interval - 1 moves, however long the game. Keyframes are BoardSnapshots, each one only holds
+	//the parts of the board that changed since the one before.
+	class Replay {
+		int _board_size;
+		int _players;
+		std::size_t _interval;
+		std::vector<TriCoord> _moves;
+		std::vector<std::uint8_t> _movers;
+		std::vector<BoardSnapshot> _keyframes; //keyframe k is the board before move k * interval
+		std::optional<int> _winner;
+		int _last_player = 0; //to move after the last move
+
+		void addKeyframe(Board& b) {
+			_keyframes.push_back(_keyframes.empty() ? BoardSnapshot(b) : _keyframes.back().after(b, b.changedTiles()));
+			b.trackChanges();
+		}
+
+	public:
+		//The game stops at the first move that wins, ends in endless explosions or isn't legal, any moves after it are dropped
+		Replay(int board_size, int players, std::span<const TriCoord> moves, std::size_t interval = 16)
+			: _board_size(board_size), _players(players), _interval(std::max<std::size_t>(interval, 1)) {
+			Board b(board_size);
+			int player = 0;
+			for (auto c : moves) {
+				if (!b.inBounds(c) || (b[c].player >= 0 && b[c].player != player)) break;
+				if (_moves.size() % _interval == 0) addKeyframe(b);
+				_moves.push_back(c);
+				_movers.push_back(static_cast<std::uint8_t>(player));
+				const auto end = playMove(b, c, player);
+				if (end == MoveEnd::Won) _winner = player;
+				if (end != MoveEnd::Continues) break;
+				player = nextActivePlayer(b, player, players);
+			}
+			if (_keyframes.empty()) addKeyframe(b);
+			_last_player = player;
+		}
+
+		explicit Replay(const RecordView& record, std::size_t interval = 16)
+			: Replay(record.board_size, record.players, [&] {
+				std::vector<TriCoord> moves;
+				moves.reserve(static_cast<std::size_t>(record.move_count));
+				record.forEachMove([&](TriCoord c) {moves.push_back(c); });
+				return moves;
+			}(), interval) {}
+
+		int boardSize() const { return _board_size; }
+		int players() const { return _players; }
+		std::size_t moveCount() const { return _moves.size(); }
+		std::optional<int> winner() const { return _winner; }
+
+		TriCoord move(std::size_t i) const { return _moves[i]; }
+		int mover(std::size_t i) const { return _movers[i]; }
+
+		//Whose turn it is after n moves
+		int toMove(std::size_t n) const {
+			return n < _movers.size() ? _movers[n] : _last_player;
+		}
+
+		std::size_t keyframeBytes() const {
+			return BoardSnapshot::bytesUsed(_keyframes);
+		}
+
+		//Sets b, a board of the game's size, to the position after the first n moves, including all their explosions
+		void seek(std::size_t n, Board& b) const {
+			n = std::min(n, _moves.size());
+			const std::size_t k = std::min(n / _interval, _keyframes.size() - 1);
+			_keyframes[k].restore(b);
+			for (std::size_t i = k * _interval; i < n; ++i) playMove(b, _moves[i], _movers[i]);
+		}
+
+		Board at(std::size_t n) const {
+			Board b(_board_size);
+			seek(n, b);
+			return b;
+		}
+	};
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <limits>
+#include <algorithm>
+#include "board.hpp"
+#include "chains.hpp"
+
+//Game tree search for two player games
+namespace search {
+
+	constexpr int win_score = 1'000'000; //minus the number of moves it takes, so faster wins score higher
+
+	//Chain score of the player to move minus the opponent's
+	int evaluate(const Board& b, int player) {
+		thread_local ChainEvaluator chains;
+		chains.rebase(b, player);
+		const int own = chains.score();
+		chains.rebase(b, 1 - player);
+		return own - chains.score();
+	}
+
+	void legalMoves(const Board& b, int player, std::vector<TriCoord>& moves) {
+		moves.clear();
+		b.iterTiles([&](TriCoord c) {
+			if (b[c].player == player || b[c].num == 0) moves.push_back(c);
+			return true;
+		});
+	}
+
+	struct Result {
+		std::optional<TriCoord> move;
+		int score;
+	};
+
+	namespace detail {
+		int alphaBeta(const Board& b, int player, int depth, int ply, int alpha, int beta) {
+			if (depth == 0) return evaluate(b, player);
+
+			std::vector<TriCoord> moves;
+			legalMoves(b, player, moves);
+			if (moves.empty()) return -win_score + ply;
+			for (auto c : moves) {
+				Board child = b;
+				int score;
+				switch (playMove(child, c, player)) {
+				case MoveEnd::Won:
+					return win_score - ply - 1;
+				case MoveEnd::Endless:
+					score = 0;
+					break;
+				default:
+					score = -alphaBeta(child, 1 - player, depth - 1, ply + 1, -beta, -alpha);
+				}
+				alpha = std::max(alpha, score);
+				if (alpha >= beta) break;
+			}
+			return alpha;
+		}
+	}
+
+	//Fixed depth alpha-beta negamax, depth counts the moves of both players
+	Result negamax(const Board& b, int player, int depth) {
+		std::vector<TriCoord> moves;
+		legalMoves(b, player, moves);
+		Result best{ {}, std::numeric_limits<int>::min() };
+		for (auto c : moves) {
+			Board child = b;
+			int score;
+			switch (playMove(child, c, player)) {
+			case MoveEnd::Won:
+				return { c, win_score - 1 };
+			case MoveEnd::Endless:
+				score = 0;
+				break;
+			default:
+				//the window starts just below the best score so far, equally good moves don't need an exact score
+				score = -detail::alphaBeta(child, 1 - player, depth - 1, 1, -win_score, best.move ? -best.score : win_score);
+			}
+			if (score > best.score) best = { c, score };
+		}
+		return best;
+	}
+}
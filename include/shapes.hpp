@@ -6,7 +6,7 @@
 #include "bezier.hpp"
 
 sf::VertexArray circArrow(sf::Vector2f center, sf::Color color, float inner, float outer, float pointextra, int num = 50) {
-	const float tau = 2 * std::acosf(-1);
+	const float tau = 2 * std::acos(-1.0f);
 	
 	sf::VertexArray ret(sf::PrimitiveType::TriangleStrip,num*2+3);
 
@@ -127,7 +127,7 @@ public:
 	}
 
 	sf::Vector2f getPoint(std::size_t index) const override {
-		const float tau = 2 * std::acosf(-1);
+		const float tau = 2 * std::acos(-1.0f);
 		const float increment = tau / (num_points*2);
 		const float angle = increment * index - tau/4;
 		sf::Vector2f ret{ std::cos(angle),std::sin(angle) };
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include "board.hpp"
+#include "random.hpp"
+
+//The 12 symmetries of the hexagonal board: the 6 ways of permuting the barycentric coordinates of a tile, each
+//with or without turning the board upside down, (a,b,c) -> (2s-1-a, 2s-1-b, 2s-1-c), which swaps up and down tiles.
+//Edge tiles stay edge tiles, so every symmetry maps a valid position onto another one with the same explosions.
+//
+//Tiles are numbered in Board::iterTiles order.
+class BoardSymmetries {
+	int _size = -1;
+	std::vector<TriCoord> _tiles;
+	std::vector<int> _tile_of; //tile number by Board::index
+	std::vector<int> _allowed;
+	std::array<std::vector<int>, 12> _image; //_image[s][t] is the tile that tile t is moved to by symmetry s
+	std::vector<std::array<std::uint64_t, 5>> _zobrist; //random number for every tile and tileCode
+
+public:
+	static constexpr int count = 12;
+
+	explicit BoardSymmetries(int size) : _size(size) {
+		Board b(size);
+		_tile_of.assign(b.tiles().size(), -1);
+		b.iterTiles([&](TriCoord c) {
+			_tile_of[b.index(c)] = static_cast<int>(_tiles.size());
+			_tiles.push_back(c);
+			_allowed.push_back(b.allowedPieces(c));
+			return true;
+		});
+
+		constexpr std::array<std::array<int, 3>, 6> permutations = { { {0,1,2},{0,2,1},{1,0,2},{1,2,0},{2,0,1},{2,1,0} } };
+		for (int s = 0; s < count; ++s) {
+			const auto& p = permutations[s % 6];
+			const bool invert = s >= 6;
+			for (auto c : _tiles) {
+				auto bary = c.bary(size);
+				std::array<int, 3> from = { bary.x, bary.y, bary.z }, to;
+				for (int i = 0; i < 3; ++i) {
+					to[i] = invert ? size * 2 - 1 - from[p[i]] : from[p[i]];
+				}
+				_image[s].push_back(_tile_of[b.index({ to[0], to[1], c.R != invert })]);
+			}
+		}
+
+		//fixed seed, hashes end up in files
+		RandomStream random(0x5E7B0A4D, static_cast<std::uint64_t>(size));
+		_zobrist.resize(_tiles.size());
+		for (auto& codes : _zobrist) {
+			for (auto& z : codes) z = random();
+		}
+	}
+
+	int size() const { return _size; }
+
+	std::size_t numTiles() const { return _tiles.size(); }
+
+	TriCoord tile(int t) const { return _tiles[t]; }
+
+	int tileNumber(TriCoord c) const { return _tile_of[c.x * 2 + c.y * _size * 4 + c.R]; }
+
+	int allowed(int t) const { return _allowed[t]; }
+
+	int image(int symmetry, int t) const { return _image[symmetry][t]; }
+
+	//Tile that symmetry maps onto t
+	int preimage(int symmetry, int t) const {
+		for (int i = 0; i < static_cast<int>(_tiles.size()); ++i) {
+			if (_image[symmetry][i] == t) return i;
+		}
+		return -1;
+	}
+
+	//0 empty, 1..allowed pieces of player, allowed+1..2*allowed pieces of someone else
+	int tileCode(const Board& b, int t, int player) const {
+		auto s = b[_tiles[t]];
+		return s.num == 0 ? 0 : s.num + (s.player == player ? 0 : _allowed[t]);
+	}
+
+	struct Canonical {
+		std::uint64_t hash;
+		int symmetry; //tile t of the canonical position is tile image(symmetry, t) of the board
+	};
+
+	//Zobrist hash of the position from player's point of view, the smallest over all its symmetric versions
+	Canonical canonicalHash(const Board& b, int player) const {
+		thread_local std::vector<int> codes;
+		codes.resize(_tiles.size());
+		for (int t = 0; t < static_cast<int>(_tiles.size()); ++t) codes[t] = tileCode(b, t, player);
+
+		Canonical best{ ~std::uint64_t(0), 0 };
+		for (int s = 0; s < count; ++s) {
+			std::uint64_t h = 0;
+			for (std::size_t t = 0; t < _tiles.size(); ++t) h ^= _zobrist[t][codes[_image[s][t]]];
+			if (h < best.hash) best = { h, s };
+		}
+		return best;
+	}
+};
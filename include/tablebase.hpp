@@ -0,0 +1,218 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <algorithm>
+#include <unordered_set>
+#include "board.hpp"
+#include "symmetry.hpp"
+#include "mapped_file.hpp"
+
+//Perfect play for two player games on boards small enough to solve completely.
+//
+//Every move adds one piece and explosions only move pieces around, so positions never repeat and fall into layers by
+//their number of pieces. generate() walks all positions reachable from the empty board layer by layer, then solves the
+//layers back to front: a position is won if a move wins right away or leads to a position lost for the opponent.
+//
+//Positions are stored from the point of view of the player to move and only once for all 12 symmetric versions,
+//as the smallest of their keys. Each tile is a digit of the key: 0 empty, 1..allowed own pieces, allowed+1..2*allowed enemy pieces.
+//
+//The file is an open addressing hash table of 64 bit slots, key in the low 48 bits and result in the high 16,
+//mapped into memory so probing only ever reads the couple of pages it needs.
+class Tablebase {
+public:
+	enum class Result : std::uint8_t {
+		Loss,
+		Draw, //only when a move sets off explosions that never stop
+		Win
+	};
+
+	//for the player to move, distance is the number of moves until the game ends when both sides play perfectly
+	struct Entry {
+		Result result;
+		int distance;
+	};
+
+private:
+	struct Header {
+		char magic[4];
+		std::uint32_t version;
+		std::uint32_t board_size;
+		std::uint32_t unused;
+		std::uint64_t slots; //always a power of two
+		std::uint64_t positions;
+	};
+
+	static constexpr std::array<char, 4> file_magic = { 'E','T','T','B' };
+	static constexpr std::uint32_t file_version = 1;
+	static constexpr std::uint64_t empty_slot = ~std::uint64_t(0);
+	static constexpr int key_bits = 48;
+	static constexpr std::uint64_t key_mask = (std::uint64_t(1) << key_bits) - 1;
+
+	MappedFile _file;
+	BoardSymmetries _symmetries;
+	const std::uint64_t* _slots = nullptr;
+	std::uint64_t _num_slots = 0;
+
+	Tablebase(MappedFile file, int size) : _file(std::move(file)), _symmetries(size) {
+		_num_slots = reinterpret_cast<const Header*>(_file.data())->slots;
+		_slots = reinterpret_cast<const std::uint64_t*>(_file.data() + sizeof(Header));
+	}
+
+	//Whether all keys of the board size fit in key_bits
+	static bool keysFit(const BoardSymmetries& sym) {
+		double combinations = 1;
+		for (std::size_t t = 0; t < sym.numTiles(); ++t) combinations *= sym.allowed(static_cast<int>(t)) * 2 + 1;
+		return combinations < static_cast<double>(key_mask);
+	}
+
+	static std::uint64_t key(const BoardSymmetries& sym, const Board& b, int player) {
+		thread_local std::vector<std::uint8_t> codes;
+		codes.resize(sym.numTiles());
+		for (std::size_t t = 0; t < codes.size(); ++t) {
+			codes[t] = static_cast<std::uint8_t>(sym.tileCode(b, static_cast<int>(t), player));
+		}
+		std::uint64_t best = empty_slot;
+		for (int s = 0; s < BoardSymmetries::count; ++s) {
+			std::uint64_t k = 0;
+			for (std::size_t t = 0; t < codes.size(); ++t) {
+				k = k * (sym.allowed(static_cast<int>(t)) * 2 + 1) + codes[sym.image(s, static_cast<int>(t))];
+			}
+			best = std::min(best, k);
+		}
+		return best;
+	}
+
+	//The position of a key with the player to move as player 0
+	static Board decode(const BoardSymmetries& sym, std::uint64_t k) {
+		Board b(sym.size());
+		for (int t = static_cast<int>(sym.numTiles()) - 1; t >= 0; --t) {
+			const int radix = sym.allowed(t) * 2 + 1;
+			const int code = static_cast<int>(k % radix);
+			k /= radix;
+			const int player = code > sym.allowed(t);
+			for (int i = 0; i < code - player * sym.allowed(t); ++i) b.incTile(sym.tile(t), player);
+		}
+		return b;
+	}
+
+	static std::uint64_t slotOf(std::uint64_t k, std::uint64_t num_slots) {
+		k ^= k >> 33;
+		k *= 0xFF51AFD7ED558CCD;
+		k ^= k >> 33;
+		return k & (num_slots - 1);
+	}
+
+	static std::uint64_t pack(std::uint64_t k, Entry e) {
+		return k | (std::uint64_t(e.result) << key_bits) | (std::uint64_t(e.distance) << (key_bits + 2));
+	}
+
+	static std::optional<Entry> find(const std::uint64_t* slots, std::uint64_t num_slots, std::uint64_t k) {
+		for (auto i = slotOf(k, num_slots); slots[i] != empty_slot; i = (i + 1) & (num_slots - 1)) {
+			if ((slots[i] & key_mask) == k) {
+				return Entry{ static_cast<Result>((slots[i] >> key_bits) & 3), static_cast<int>(slots[i] >> (key_bits + 2)) };
+			}
+		}
+		return {};
+	}
+
+public:
+	static std::optional<Tablebase> open(const std::string& path) {
+		auto file = MappedFile::openReadOnly(path);
+		if (!file || file->size() < sizeof(Header)) return {};
+		Header header;
+		std::memcpy(&header, file->data(), sizeof(header));
+		if (std::memcmp(header.magic, file_magic.data(), file_magic.size()) != 0 || header.version != file_version) return {};
+		if (file->size() != sizeof(Header) + header.slots * sizeof(std::uint64_t)) return {};
+		return Tablebase(std::move(*file), static_cast<int>(header.board_size));
+	}
+
+	int boardSize() const {
+		return _symmetries.size();
+	}
+
+	//O(1): one key computation and a short probe sequence in the mapped table
+	std::optional<Entry> probe(const Board& b, int player_to_move) const {
+		if (b.size() != boardSize() || b.playerTotals().size() > 2) return {};
+		return find(_slots, _num_slots, key(_symmetries, b, player_to_move));
+	}
+
+	//Solves every position of the board size and writes them to path.
+	//Gives up, returning nothing, if there are more than max_positions of them or their keys don't fit.
+	//on_layer(pieces, positions with that many pieces) is called as the layers are found.
+	static std::optional<std::size_t> generate(int size, const std::string& path, std::size_t max_positions, auto on_layer) {
+		const BoardSymmetries sym(size);
+		if (!keysFit(sym)) return {};
+
+		std::vector<std::vector<std::uint64_t>> layers = { { key(sym, Board(size), 0) } };
+		std::size_t positions = 1;
+		while (!layers.back().empty()) {
+			std::unordered_set<std::uint64_t> next;
+			for (auto k : layers.back()) {
+				const Board b = decode(sym, k);
+				for (std::size_t t = 0; t < sym.numTiles(); ++t) {
+					const TriCoord c = sym.tile(static_cast<int>(t));
+					if (b[c].player == 1) continue;
+					Board child = b;
+					if (playMove(child, c, 0) == MoveEnd::Continues) next.insert(key(sym, child, 1));
+				}
+				if (positions + next.size() > max_positions) return {};
+			}
+			positions += next.size();
+			on_layer(layers.size(), next.size());
+			layers.emplace_back(next.begin(), next.end());
+		}
+
+		std::uint64_t num_slots = 1;
+		while (num_slots < positions * 2) num_slots *= 2;
+		auto file = MappedFile::openWritable(path, sizeof(Header) + num_slots * sizeof(std::uint64_t));
+		if (!file) return {};
+		Header header{};
+		std::memcpy(header.magic, file_magic.data(), file_magic.size());
+		header.version = file_version;
+		header.board_size = static_cast<std::uint32_t>(size);
+		header.slots = num_slots;
+		header.positions = positions;
+		std::memcpy(file->data(), &header, sizeof(header));
+		auto* slots = reinterpret_cast<std::uint64_t*>(file->data() + sizeof(Header));
+		std::fill(slots, slots + num_slots, empty_slot);
+
+		//every move leads into the next layer, which is already solved by the time a layer is looked at
+		for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer) {
+			for (auto k : *layer) {
+				const Board b = decode(sym, k);
+				std::optional<int> fastest_win, slowest_loss;
+				bool draw = false;
+				for (std::size_t t = 0; t < sym.numTiles() && fastest_win != 1; ++t) {
+					const TriCoord c = sym.tile(static_cast<int>(t));
+					if (b[c].player == 1) continue;
+					Board child = b;
+					switch (playMove(child, c, 0)) {
+					case MoveEnd::Won:
+						fastest_win = 1;
+						break;
+					case MoveEnd::Endless:
+						draw = true;
+						break;
+					case MoveEnd::Continues: {
+						auto e = *find(slots, num_slots, key(sym, child, 1));
+						if (e.result == Result::Loss) fastest_win = std::min(fastest_win.value_or(e.distance + 1), e.distance + 1);
+						else if (e.result == Result::Draw) draw = true;
+						else slowest_loss = std::max(slowest_loss.value_or(0), e.distance + 1);
+						break;
+					}
+					}
+				}
+
+				Entry e = fastest_win ? Entry{ Result::Win, *fastest_win } : draw ? Entry{ Result::Draw, 0 } : Entry{ Result::Loss, slowest_loss.value_or(0) };
+				auto i = slotOf(k, num_slots);
+				while (slots[i] != empty_slot) i = (i + 1) & (num_slots - 1);
+				slots[i] = pack(k, e);
+			}
+		}
+		return positions;
+	}
+};
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cmath>
+#include <cstdlib>
+#include <optional>
+#include "game.hpp"
+#include "random.hpp"
+#include "game_record.hpp"
+
+//Headless games between named AI strategies, spread over worker threads
+namespace tournament {
+
+	using PlayerFactory = std::function<std::unique_ptr<Player>(RandomStream)>;
+
+	struct Strategy {
+		std::string name;
+		PlayerFactory make;
+		std::function<void()> finish = {}; //called once the games are over, by every process that played some
+	};
+
+	//Searches for the players of one smp strategy. A player gets one that no other player is using, so tables carry
+	//over from game to game and each of them is merged into the table file once, by save() at the end.
+	class SearchPool {
+		search::ParallelSearch::Settings _settings;
+		std::mutex _mutex;
+		std::vector<std::shared_ptr<search::ParallelSearch>> _searches;
+
+	public:
+		explicit SearchPool(const search::ParallelSearch::Settings& settings) : _settings(settings) {}
+
+		std::shared_ptr<search::ParallelSearch> take() {
+			std::scoped_lock lock(_mutex);
+			//only the pool can hand out new references, so a search held by nothing else stays free
+			for (auto& s : _searches) {
+				if (s.use_count() == 1) return s;
+			}
+			return _searches.emplace_back(std::make_shared<search::ParallelSearch>(_settings));
+		}
+
+		void save() {
+			std::scoped_lock lock(_mutex);
+			for (auto& s : _searches) s->save();
+		}
+	};
+
+	//Falls back on a random move whenever the filters of a strategy leave nothing
+	template<AI::Filter F>
+	PlayerFactory filteredStrategy(F filter) {
+		return [filter](RandomStream random) {
+			auto random_move = AI::randomAI(random);
+			return AI::makeAIPlayer(AI::firstSuccess(
+				AI::filtered(filter, random_move),
+				random_move
+			));
+		};
+	}
+
+	//Known names are random, greedy, biggest, heuristic, chains, maxn, maxn:<depth>, smp, smp:<threads>:<milliseconds>[:<table file>], heuristic:<weights file>, chains:<weights file>, ntuple:<weights file>
+	//and tablebase:<file> or book:<file>, which play like chains outside of the positions they cover
+	std::optional<Strategy> strategyByName(const std::string& name) {
+		if (name == "random") return Strategy{ name, [](RandomStream random) {return AI::makeAIPlayer(AI::randomAI(random)); } };
+		if (name == "greedy") return Strategy{ name, filteredStrategy(AI::maxGain) };
+		if (name == "biggest") return Strategy{ name, filteredStrategy(AI::biggestExplosion) };
+		if (name == "heuristic") return Strategy{ name, filteredStrategy(AI::heuristic) };
+		if (name == "chains") return Strategy{ name, filteredStrategy(AI::chains_heuristic) };
+		if (name == "maxn" || name.starts_with("maxn:")) {
+			//max-n depth after the colon, the games here have two players
+			const int depth = name == "maxn" ? 2 : std::atoi(name.c_str() + 5);
+			if (depth < 1) return {};
+			return Strategy{ name, [depth](RandomStream random) {
+				auto random_move = AI::randomAI(random);
+				return AI::makeAIPlayer(AI::firstSuccess(AI::maxN(2, depth), random_move));
+			} };
+		}
+		if (name == "smp" || name.starts_with("smp:")) {
+			//smp:<threads>:<milliseconds per move>:<table file>, all cores, 300ms and no saved table by default
+			search::ParallelSearch::Settings search_settings;
+			search_settings.threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+			search_settings.time_limit = std::chrono::milliseconds(300);
+			search_settings.table_bytes = std::size_t(4) << 20; //every player of every game running at once has its own
+			if (name.size() > 4) {
+				const auto colon = name.find(':', 4);
+				search_settings.threads = std::atoi(name.c_str() + 4);
+				if (colon != std::string::npos) {
+					search_settings.time_limit = std::chrono::milliseconds(std::atoi(name.c_str() + colon + 1));
+					if (auto file = name.find(':', colon + 1); file != std::string::npos) search_settings.table_file = name.substr(file + 1);
+				}
+				if (search_settings.threads < 1 || search_settings.time_limit.count() < 1) return {};
+			}
+			auto pool = std::make_shared<SearchPool>(search_settings);
+			return Strategy{ name, [pool](RandomStream random) {
+				auto random_move = AI::randomAI(random);
+				return AI::makeAIPlayer(AI::firstSuccess(
+					AI::parallelSearch(pool->take()),
+					AI::filtered(AI::chains_heuristic, random_move),
+					random_move
+				));
+			}, [pool] {pool->save(); } };
+		}
+		if (name.starts_with("heuristic:") || name.starts_with("chains:")) {
+			const bool chains = name.starts_with("chains:");
+			auto weights = HeuristicWeights::load(name.substr(name.find(':') + 1));
+			if (!weights) return {};
+			if (chains) return Strategy{ name, filteredStrategy(AI::weightedChains(*weights)) };
+			return Strategy{ name, filteredStrategy(AI::weightedHeuristic(*weights)) };
+		}
+		if (name.starts_with("tablebase:")) {
+			auto table = Tablebase::open(name.substr(10));
+			if (!table) return {};
+			auto shared = std::make_shared<const Tablebase>(std::move(*table));
+			return Strategy{ name, [shared](RandomStream random) {
+				auto random_move = AI::randomAI(random);
+				return AI::makeAIPlayer(AI::firstSuccess(
+					AI::tablebase(*shared),
+					AI::filtered(AI::chains_heuristic, random_move),
+					random_move
+				));
+			} };
+		}
+		if (name.starts_with("book:")) {
+			auto book = OpeningBook::open(name.substr(5));
+			if (!book) return {};
+			auto shared = std::make_shared<const OpeningBook>(std::move(*book));
+			return Strategy{ name, [shared](RandomStream random) {
+				auto random_move = AI::randomAI(random);
+				return AI::makeAIPlayer(AI::firstSuccess(
+					AI::book(*shared),
+					AI::filtered(AI::chains_heuristic, random_move),
+					random_move
+				));
+			} };
+		}
+		if (name.starts_with("ntuple:")) {
+			auto net = NTupleNetwork::load(name.substr(7));
+			if (!net) return {};
+			auto shared = std::make_shared<const NTupleNetwork>(std::move(*net));
+			return Strategy{ name, [shared, filter = filteredStrategy(AI::ntuple(*shared))](RandomStream random) {return filter(random); } };
+		}
+		return {};
+	}
+
+	enum class Schedule {
+		RoundRobin, //every strategy plays every other one
+		Gauntlet //the first strategy plays every other one
+	};
+
+	struct Settings {
+		std::vector<Strategy> strategies;
+		std::vector<int> board_sizes = { 3 };
+		int games_per_pairing = 100; //per board size, colors alternate between games
+		int threads = 1;
+		Schedule schedule = Schedule::RoundRobin;
+		std::uint64_t seed = 0;
+		int max_steps = 100000; //games still running after this many steps count as a draw
+	};
+
+	struct Pairing {
+		int first, second;
+		int wins = 0, losses = 0, draws = 0; //from the point of view of first
+
+		int games() const { return wins + losses + draws; }
+
+		double score() const {
+			return games() ? (wins + draws * 0.5) / games() : 0.5;
+		}
+	};
+
+	//Elo difference for a score fraction, clamped so perfect scores stay finite
+	double eloFromScore(double score) {
+		score = std::clamp(score, 0.001, 0.999);
+		return -400 * std::log10(1 / score - 1);
+	}
+
+	struct EloEstimate {
+		double elo, low, high; //95% confidence interval
+	};
+
+	//Elo of first relative to second, with the interval taken from the standard error of the per-game score
+	EloEstimate estimateElo(int wins, int losses, int draws) {
+		const int n = wins + losses + draws;
+		if (n == 0) return { 0,0,0 };
+		const double score = (wins + draws * 0.5) / n;
+		const double variance = (wins * std::pow(1 - score, 2) + draws * std::pow(0.5 - score, 2) + losses * std::pow(score, 2)) / n;
+		const double margin = 1.96 * std::sqrt(variance / n);
+		return { eloFromScore(score), eloFromScore(score - margin), eloFromScore(score + margin) };
+	}
+
+	struct Results {
+		std::vector<Pairing> pairings;
+		long long total_steps = 0;
+		double seconds = 0;
+
+		//performance of a strategy against the whole field it played
+		EloEstimate elo(int strategy) const {
+			int wins = 0, losses = 0, draws = 0;
+			for (auto& p : pairings) {
+				if (p.first == strategy) {
+					wins += p.wins;
+					losses += p.losses;
+					draws += p.draws;
+				}
+				else if (p.second == strategy) {
+					wins += p.losses;
+					losses += p.wins;
+					draws += p.draws;
+				}
+			}
+			return estimateElo(wins, losses, draws);
+		}
+	};
+
+	struct GameOutcome {
+		std::optional<int> winner;
+		long long steps;
+	};
+
+	//Records the moves into record when there is one
+	GameOutcome playGame(int size, std::unique_ptr<Player> first, std::unique_ptr<Player> second, int max_steps, records::GameRecord* record = nullptr) {
+		BoardWithPlayers game(size);
+		game.addPlayer(std::move(first));
+		game.addPlayer(std::move(second));
+		if (record) game.setMoveListener([record](TriCoord c, int) { record->addMove(c); });
+		auto result = game.playToCompletion(max_steps);
+		if (record) record->winner = result.winner;
+		return { result.winner, result.steps };
+	}
+
+	//Which games make up a tournament. Game i is played on board_sizes[i / games_per_size],
+	//in pairing (i % games_per_size) / games_per_pairing, with the colors swapped for odd i.
+	struct Plan {
+		std::vector<Pairing> pairings;
+		long long games_per_size = 0;
+		long long total_games = 0;
+	};
+
+	Plan makePlan(const Settings& settings) {
+		Plan plan;
+		const int n = static_cast<int>(settings.strategies.size());
+		for (int a = 0; a < n; ++a) {
+			for (int b = a + 1; b < n; ++b) {
+				if (settings.schedule == Schedule::Gauntlet && a != 0) continue;
+				plan.pairings.push_back({ a,b });
+			}
+		}
+		plan.games_per_size = static_cast<long long>(plan.pairings.size()) * settings.games_per_pairing;
+		plan.total_games = plan.games_per_size * settings.board_sizes.size();
+		return plan;
+	}
+
+	//The player in seat s of game i draws from RandomStream(seed, i, s), so any game plays out the
+	//same no matter which thread or process ends up playing it and can be replayed on its own.
+	//Records get the tournament seed for both seats, together with the game number and seat it names the stream.
+	GameOutcome playScheduledGame(const Settings& settings, const Plan& plan, long long game, records::GameRecord* record = nullptr) {
+		const int size = settings.board_sizes[game / plan.games_per_size];
+		const Pairing& pairing = plan.pairings[(game % plan.games_per_size) / settings.games_per_pairing];
+		const bool swapped = game % 2 == 1;
+
+		auto& first = settings.strategies[swapped ? pairing.second : pairing.first];
+		auto& second = settings.strategies[swapped ? pairing.first : pairing.second];
+		if (record) {
+			*record = records::GameRecord(size);
+			record->game = static_cast<std::uint64_t>(game);
+			record->players = { { first.name, settings.seed }, { second.name, settings.seed } };
+		}
+		return playGame(size, first.make(RandomStream(settings.seed, game, 0)), second.make(RandomStream(settings.seed, game, 1)), settings.max_steps, record);
+	}
+
+	void addOutcome(Results& results, const Plan& plan, const Settings& settings, long long game, GameOutcome outcome) {
+		Pairing& pairing = results.pairings[(game % plan.games_per_size) / settings.games_per_pairing];
+		const bool swapped = game % 2 == 1;
+		results.total_steps += outcome.steps;
+		if (!outcome.winner) pairing.draws++;
+		else if ((*outcome.winner == 0) != swapped) pairing.wins++;
+		else pairing.losses++;
+	}
+
+	void finishStrategies(const Settings& settings) {
+		for (auto& s : settings.strategies) {
+			if (s.finish) s.finish();
+		}
+	}
+
+	//on_game(results so far) is called with the results locked after every finished game.
+	//Every game is written to writer too if there is one, in the order they finish.
+	Results run(const Settings& settings, auto on_game, records::Writer* writer = nullptr) {
+		const Plan plan = makePlan(settings);
+		Results results;
+		results.pairings = plan.pairings;
+		std::atomic<long long> next_game = 0;
+		std::mutex results_mutex;
+
+		auto start = std::chrono::steady_clock::now();
+		auto worker = [&]() {
+			for (long long i = next_game++; i < plan.total_games; i = next_game++) {
+				records::GameRecord record(0);
+				auto outcome = playScheduledGame(settings, plan, i, writer ? &record : nullptr);
+				std::scoped_lock lock(results_mutex);
+				if (writer) writer->write(record);
+				addOutcome(results, plan, settings, i, outcome);
+				on_game(std::as_const(results));
+			}
+		};
+
+		{
+			std::vector<std::jthread> threads;
+			for (int t = 1; t < settings.threads; ++t) {
+				threads.emplace_back(worker);
+			}
+			worker();
+		}
+		finishStrategies(settings);
+		results.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return results;
+	}
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <algorithm>
+#include "mapped_file.hpp"
+
+namespace search {
+
+	//Hash table of search results shared by all threads of a search without any locks.
+	//
+	//Every slot is two 64 bit words, the packed entry and the entry xor the position's hash. Threads write and read both words
+	//with plain atomic stores and loads, so a slot that is being overwritten can be read half old and half new,
+	//but then the words don't xor to the hash any more and the slot is just treated as missing.
+	//Four slots make a bucket of exactly one cache line, a probe never touches more than that.
+	//
+	//A table can also be saved to a file that holds the buckets just like they are in memory, behind a header of one
+	//cache line. open() maps such a file read only, so it costs nothing to load and any number of processes can
+	//probe the same one at once. mergeInto() adds the entries of a run to the file. The same checksums that keep threads apart
+	//make slots that another process is merging into at that moment read as missing.
+	class TranspositionTable {
+	public:
+		enum class Bound : std::uint8_t {
+			Exact,
+			Lower, //the score is at least this
+			Upper //the score is at most this
+		};
+
+		//Deepest depth an entry can hold, deeper ones are stored as this deep
+		static constexpr int max_depth = 254;
+
+		struct Entry {
+			int score;
+			int depth; //0 to max_depth, the packed entry has 8 bits for it
+			Bound bound;
+			int move = -1; //tile number of the best move in the canonical position, -1 if there is none
+		};
+
+	private:
+		struct Slot {
+			std::atomic<std::uint64_t> check{ 0 }; //hash ^ data
+			std::atomic<std::uint64_t> data{ 0 }; //0 for empty slots
+		};
+
+		struct alignas(64) Bucket {
+			std::array<Slot, 4> slots;
+		};
+		static_assert(sizeof(Bucket) == 64);
+
+		struct alignas(64) Header {
+			char magic[4];
+			std::uint32_t version;
+			std::uint32_t board_size;
+			std::uint32_t unused;
+			std::uint64_t buckets;
+		};
+
+		static constexpr std::array<char, 4> file_magic = { 'E','T','T','T' };
+		static constexpr std::uint32_t file_version = 1;
+
+		std::vector<Bucket> _memory;
+		std::optional<MappedFile> _file;
+		Bucket* _buckets = nullptr;
+		std::size_t _num_buckets = 0;
+
+		explicit TranspositionTable(MappedFile file) : _file(std::move(file)) {
+			_buckets = reinterpret_cast<Bucket*>(_file->data() + sizeof(Header));
+			_num_buckets = (_file->size() - sizeof(Header)) / sizeof(Bucket);
+		}
+
+		//score in the low 32 bits, then depth + 1, bound and move + 1.
+		//Depth is clamped so it never spills into the bits of the bound and move.
+		static std::uint64_t pack(const Entry& e) {
+			return std::uint64_t(static_cast<std::uint32_t>(e.score)) | (std::uint64_t(std::clamp(e.depth, 0, max_depth) + 1) << 32) | (std::uint64_t(e.bound) << 40) | (std::uint64_t(e.move + 1) << 42);
+		}
+
+		static Entry unpack(std::uint64_t data) {
+			return { static_cast<std::int32_t>(static_cast<std::uint32_t>(data)), static_cast<int>((data >> 32) & 0xFF) - 1, static_cast<Bound>((data >> 40) & 3), static_cast<int>((data >> 42) & 0xFFFF) - 1 };
+		}
+
+		Bucket& bucketOf(std::uint64_t hash) const {
+			return _buckets[hash % _num_buckets];
+		}
+
+		static std::optional<Header> readHeader(const MappedFile& file) {
+			if (file.size() < sizeof(Header)) return {};
+			Header header;
+			std::memcpy(&header, file.data(), sizeof(header));
+			if (std::memcmp(header.magic, file_magic.data(), file_magic.size()) != 0 || header.version != file_version || header.buckets == 0) return {};
+			if (file.size() != sizeof(Header) + header.buckets * sizeof(Bucket)) return {};
+			return header;
+		}
+
+		//Same as store(), but keeps entries that were searched deeper
+		void storeDeeper(std::uint64_t hash, const Entry& e) {
+			if (auto old = probe(hash); old && old->depth > e.depth) return;
+			store(hash, e);
+		}
+
+	public:
+		explicit TranspositionTable(std::size_t bytes = std::size_t(16) << 20) : _memory(std::max<std::size_t>(bytes / sizeof(Bucket), 1)) {
+			_buckets = _memory.data();
+			_num_buckets = _memory.size();
+		}
+
+		//A table saved for board_size, read only. Nothing if there is none.
+		static std::optional<TranspositionTable> open(const std::string& path, int board_size) {
+			auto file = MappedFile::openReadOnly(path);
+			if (!file) return {};
+			auto header = readHeader(*file);
+			if (!header || header->board_size != static_cast<std::uint32_t>(board_size)) return {};
+			return TranspositionTable(std::move(*file));
+		}
+
+		std::optional<Entry> probe(std::uint64_t hash) const {
+			for (auto& slot : bucketOf(hash).slots) {
+				const auto data = slot.data.load(std::memory_order_relaxed);
+				if (data != 0 && (slot.check.load(std::memory_order_relaxed) ^ data) == hash) return unpack(data);
+			}
+			return {};
+		}
+
+		//Takes the slot of the same position if there is one, otherwise the one searched least deep.
+		//Not for tables opened from a file.
+		void store(std::uint64_t hash, const Entry& e) {
+			auto& slots = bucketOf(hash).slots;
+			Slot* target = &slots[0];
+			int shallowest = 1 << 30;
+			for (auto& slot : slots) {
+				const auto data = slot.data.load(std::memory_order_relaxed);
+				if (data == 0 || (slot.check.load(std::memory_order_relaxed) ^ data) == hash) {
+					target = &slot;
+					break;
+				}
+				if (unpack(data).depth < shallowest) {
+					shallowest = unpack(data).depth;
+					target = &slot;
+				}
+			}
+			const auto data = pack(e);
+			target->data.store(data, std::memory_order_relaxed);
+			target->check.store(hash ^ data, std::memory_order_relaxed);
+		}
+
+		void clear() {
+			for (std::size_t i = 0; i < _num_buckets; ++i) {
+				for (auto& slot : _buckets[i].slots) {
+					slot.data.store(0, std::memory_order_relaxed);
+					slot.check.store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		//Adds every entry to the table saved at path, except where the file already has the position searched deeper.
+		//The file is created as big as this table if there isn't one yet. Processes merging into the same file take turns.
+		bool mergeInto(const std::string& path, int board_size) const {
+			auto lock = FileLock::exclusive(path + ".lock");
+			if (!lock) return false;
+
+			std::size_t num_buckets = _num_buckets;
+			if (auto existing = MappedFile::openReadOnly(path); existing) {
+				auto header = readHeader(*existing);
+				if (!header || header->board_size != static_cast<std::uint32_t>(board_size)) return false;
+				num_buckets = static_cast<std::size_t>(header->buckets);
+			}
+			auto file = MappedFile::openWritable(path, sizeof(Header) + num_buckets * sizeof(Bucket));
+			if (!file) return false;
+			Header header{};
+			std::memcpy(header.magic, file_magic.data(), file_magic.size());
+			header.version = file_version;
+			header.board_size = static_cast<std::uint32_t>(board_size);
+			header.buckets = num_buckets;
+			std::memcpy(file->data(), &header, sizeof(header));
+
+			TranspositionTable target(std::move(*file));
+			for (std::size_t i = 0; i < _num_buckets; ++i) {
+				for (auto& slot : _buckets[i].slots) {
+					const auto data = slot.data.load(std::memory_order_relaxed);
+					if (data != 0) target.storeDeeper(slot.check.load(std::memory_order_relaxed) ^ data, unpack(data));
+				}
+			}
+			return true;
+		}
+	};
+}
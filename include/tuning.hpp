@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <string_view>
+#include <algorithm>
+#include "weights.hpp"
+#include "random.hpp"
+#include "tournament.hpp"
+
+//Tunes HeuristicWeights by self-play with SPSA (simultaneous perturbation stochastic approximation).
+//
+//Every iteration moves all weights by +c or -c at random, plays the two resulting players against each other
+//and steps the weights towards whichever side won more often. One match per iteration estimates the
+//gradient for every weight at once, and the match is played on all threads through tournament::run.
+//
+//The weights are tuned scaled up to scale times the defaults, so steps smaller than a default unit aren't rounded
+//away, which doesn't change how they play. spsa() hands them out at that scale and records it in them, so tuning
+//its own output again carries on where it left off instead of scaling it up once more.
+namespace tuning {
+
+	enum class Evaluator {
+		Heuristic,
+		Chains
+	};
+
+	struct Settings {
+		Evaluator evaluator = Evaluator::Chains;
+		int iterations = 200;
+		int games_per_iteration = 64; //rounded up to an even number so both sides play both colors
+		int board_size = 3;
+		int threads = 1;
+		std::uint64_t seed = 0;
+		int scale = 8;
+		double a = 60; //step size, in scaled weight units per unit of score difference
+		double c = 2; //perturbation size, in scaled weight units
+		int max_steps = 100000;
+	};
+
+	tournament::Strategy strategyFor(Evaluator evaluator, const HeuristicWeights& weights, std::string name) {
+		if (evaluator == Evaluator::Heuristic) return { std::move(name), tournament::filteredStrategy(AI::weightedHeuristic(weights)) };
+		return { std::move(name), tournament::filteredStrategy(AI::weightedChains(weights)) };
+	}
+
+	//Only the weights the evaluator uses get tuned
+	std::vector<std::size_t> tunedFields(Evaluator evaluator) {
+		std::vector<std::size_t> ret;
+		for (std::size_t i = 0; i < HeuristicWeights::fields.size(); ++i) {
+			const bool chain_field = std::string_view(HeuristicWeights::fields[i].first).starts_with("chain_") || std::string_view(HeuristicWeights::fields[i].first) == "loose_piece";
+			if (chain_field == (evaluator == Evaluator::Chains)) ret.push_back(i);
+		}
+		return ret;
+	}
+
+	HeuristicWeights toWeights(HeuristicWeights base, const std::vector<std::size_t>& tuned, const std::vector<double>& theta) {
+		for (std::size_t i = 0; i < tuned.size(); ++i) {
+			base.*(HeuristicWeights::fields[tuned[i]].second) = static_cast<int>(std::lround(theta[i]));
+		}
+		return base;
+	}
+
+	//on_iteration(iteration, current weights, score of the + side in that iteration's match)
+	HeuristicWeights spsa(HeuristicWeights start, const Settings& settings, auto on_iteration) {
+		const auto tuned = tunedFields(settings.evaluator);
+		//weights already at the scale or finer stay as they are
+		const int factor = std::max(settings.scale / std::max(start.scale, 1), 1);
+		for (auto& [name, field] : HeuristicWeights::fields) {
+			start.*field *= factor;
+		}
+		start.scale = std::max(start.scale, 1) * factor;
+		std::vector<double> theta, plus(tuned.size()), minus(tuned.size());
+		for (auto f : tuned) {
+			theta.push_back(start.*(HeuristicWeights::fields[f].second));
+		}
+
+		RandomStream random(settings.seed, 0);
+		std::vector<double> delta(tuned.size());
+		const double stability = settings.iterations * 0.1;
+		for (int k = 0; k < settings.iterations; ++k) {
+			//the usual SPSA gain sequences
+			const double a_k = settings.a / std::pow(k + 1 + stability, 0.602);
+			const double c_k = settings.c / std::pow(k + 1, 0.101);
+			for (std::size_t i = 0; i < tuned.size(); ++i) {
+				delta[i] = random.below(2) ? 1 : -1;
+				plus[i] = theta[i] + c_k * delta[i];
+				minus[i] = theta[i] - c_k * delta[i];
+			}
+
+			tournament::Settings match;
+			match.strategies = {
+				strategyFor(settings.evaluator, toWeights(start, tuned, plus), "plus"),
+				strategyFor(settings.evaluator, toWeights(start, tuned, minus), "minus")
+			};
+			match.board_sizes = { settings.board_size };
+			match.games_per_pairing = (settings.games_per_iteration + 1) / 2 * 2;
+			match.threads = settings.threads;
+			match.seed = RandomStream(settings.seed, 1, k)();
+			match.max_steps = settings.max_steps;
+			const double score = tournament::run(match, [](auto&) {}).pairings[0].score();
+
+			//score - (1 - score) is the plus side's advantage, the gradient for weight i is that over 2 c_k delta_i
+			const double gradient = (2 * score - 1) / (2 * c_k);
+			for (std::size_t i = 0; i < tuned.size(); ++i) {
+				theta[i] += a_k * gradient * delta[i];
+			}
+			on_iteration(k, toWeights(start, tuned, theta), score);
+		}
+		return toWeights(start, tuned, theta);
+	}
+}
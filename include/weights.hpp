@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <optional>
+#include <utility>
+
+//Constants of the hand written evaluations, AI::heuristic and AI::chains_heuristic.
+//Only the ratios between them matter for which move gets picked, scaling them all up doesn't change how the AIs play.
+struct HeuristicWeights {
+	//BoardFeatures::heuristicScore
+	int piece = 1; //every own piece
+	int threatened = -5; //own tile next to an enemy tile that's about to explode
+	int threatened_critical = -3; //on top of that if the threatened tile was about to explode itself
+	int safe = 3; //own tile that isn't threatened
+	int safe_critical = 3; //own tile that's about to explode and isn't threatened
+	int safe_critical_piece = -1; //per piece on such a tile, so tiles that need fewer pieces to explode count more
+	int safe_critical_neighbor = 1; //per occupied tile next to one, which its explosion would take
+
+	//ChainEvaluator
+	int chain_threatened = -7; //per own piece in a chain containing an enemy tile
+	int chain_safe = 3; //per own piece in a chain that isn't threatened
+	int chain_capture = 2; //per enemy piece next to a safe chain
+	int loose_piece = 1; //per own piece that isn't in or next to a chain
+
+	int scale = 1; //how many times the scale of the defaults these weights are, tuning works at a finer scale than them
+
+	static constexpr std::array<std::pair<const char*, int HeuristicWeights::*>, 11> fields = { {
+		{ "piece", &HeuristicWeights::piece },
+		{ "threatened", &HeuristicWeights::threatened },
+		{ "threatened_critical", &HeuristicWeights::threatened_critical },
+		{ "safe", &HeuristicWeights::safe },
+		{ "safe_critical", &HeuristicWeights::safe_critical },
+		{ "safe_critical_piece", &HeuristicWeights::safe_critical_piece },
+		{ "safe_critical_neighbor", &HeuristicWeights::safe_critical_neighbor },
+		{ "chain_threatened", &HeuristicWeights::chain_threatened },
+		{ "chain_safe", &HeuristicWeights::chain_safe },
+		{ "chain_capture", &HeuristicWeights::chain_capture },
+		{ "loose_piece", &HeuristicWeights::loose_piece },
+	} };
+
+	bool operator==(const HeuristicWeights&) const = default;
+
+	//Text file with one "name value" line per weight and a "scale" line, missing names keep their default
+	bool save(const std::string& path) const {
+		std::ofstream out(path);
+		for (auto& [name, field] : fields) {
+			out << name << ' ' << this->*field << '\n';
+		}
+		out << "scale " << scale << '\n';
+		return static_cast<bool>(out);
+	}
+
+	static std::optional<HeuristicWeights> load(const std::string& path) {
+		std::ifstream in(path);
+		if (!in) return {};
+		HeuristicWeights ret;
+		std::string name;
+		int value;
+		while (in >> name >> value) {
+			if (name == "scale") {
+				if (value < 1) return {};
+				ret.scale = value;
+				continue;
+			}
+			auto field = std::ranges::find(fields, name, [](auto& f) {return std::string(f.first); });
+			if (field == fields.end()) return {};
+			ret.*(field->second) = value;
+		}
+		if (!in.eof()) return {};
+		return ret;
+	}
+};
@@ -2,125 +2,566 @@
 #include <algorithm>
 #include <concepts>
 #include <ranges>
+#include <string>
+#include <cmath>
+#include <stdexcept>
 #include "game.hpp"
+#include "tournament.hpp"
+#include "distributed.hpp"
+#include "tuning.hpp"
+#include "dfpn.hpp"
+#include "game_pool.hpp"
+#include "game_record.hpp"
+#include "replay.hpp"
+#include "corpus.hpp"
+#include "engine.hpp"
+#include "mapped_file.hpp"
+#include <fstream>
+#include <map>
 
-AI::Filter auto heuristic = AI::maxFitness([](const Board& board, int player, int) {
-	if (board.isWon()) return std::numeric_limits<int>::max();
-
-	struct Set {
-		size_t parent;
-		size_t num_owned = 0; //how many of our own pieces are in this set
-		bool threatened = false; //is this set threatened by an enemy explosion next turn?
-		size_t num_threatened_by = 0; //Number of enemy pieces threatened by this set
-	};
+//Trains an N-tuple network by self-play, then plays it against chains_heuristic
+int trainNTuple(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " train-ntuple <weights file> [games] [threads] [board size]\n";
+		return 1;
+	}
+	const std::string path = argv[2];
+	const int games = argc > 3 ? std::stoi(argv[3]) : 10000;
+	const int threads = argc > 4 ? std::stoi(argv[4]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	const int size = argc > 5 ? std::stoi(argv[5]) : 3;
 
-	auto fill = std::views::iota( 0, board.size() * board.size() * 8 ) | std::views::transform( [](size_t i) {return Set{i}; } );
-	std::vector<Set> sets(fill.begin(),fill.end());
+	NTupleNetwork net = NTupleNetwork::load(path).value_or(NTupleNetwork{});
+	NTupleTrainer trainer(net);
+	trainer.board_size = size;
+	int next_report = 0;
+	trainer.train(games, threads, std::random_device{}(), [&](int done) {
+		if (done >= next_report) {
+			std::cout << "Trained on " << done << " games\n";
+			next_report += std::max(games / 10, 1);
+		}
+	});
+	if (!net.save(path)) {
+		std::cerr << "Could not write " << path << '\n';
+		return 1;
+	}
 
-	auto coord_to_set = [&board](TriCoord c) -> size_t {
-		return c.x * 2 + c.y * board.size() * 4 + c.R;
-	};
+	const std::uint64_t seed = std::random_device{}();
+	BoardWithPlayers game(size);
+	game.addPlayer(AI::makeAIPlayer(AI::filtered(AI::ntuple(net), AI::randomAI(RandomStream(seed, 0)))));
+	game.addPlayer(AI::makeAIPlayer(AI::filtered(AI::chains_heuristic, AI::randomAI(RandomStream(seed, 1)))));
+	std::vector<int> wins(game.getPlayerCount());
+	int draws = 0;
+	for (int i = 0; i < 200; ++i) {
+		game.reset();
+		//same turn limit as the self-play games, and the step limit of tournaments for explosions that never end
+		const auto result = game.runTurns(trainer.max_turns, 100000);
+		if (result.winner) wins[*result.winner]++;
+		else ++draws;
+	}
+	std::cout << "N-tuple vs chains: " << wins[0] << ' ' << wins[1] << ", " << draws << " draws\n";
+	return 0;
+}
 
-	auto parent = [&sets](size_t x) -> size_t& {
-		return sets[x].parent;
-	};
+//Tunes the weights of heuristic or chains_heuristic with SPSA, then plays the result against the default weights
+int tuneWeights(int argc, char** argv) {
+	if (argc < 4 || (std::string(argv[2]) != "heuristic" && std::string(argv[2]) != "chains")) {
+		std::cerr << "usage: " << argv[0] << " tune <heuristic|chains> <weights file> [iterations] [games per iteration] [threads] [board size]\n";
+		return 1;
+	}
+	tuning::Settings settings;
+	settings.evaluator = std::string(argv[2]) == "heuristic" ? tuning::Evaluator::Heuristic : tuning::Evaluator::Chains;
+	const std::string path = argv[3];
+	if (argc > 4) settings.iterations = std::stoi(argv[4]);
+	if (argc > 5) settings.games_per_iteration = std::stoi(argv[5]);
+	settings.threads = argc > 6 ? std::stoi(argv[6]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	if (argc > 7) settings.board_size = std::stoi(argv[7]);
+	settings.seed = std::random_device{}();
 
-	auto find = [&parent](size_t x) {
-		while (parent(x) != x) {
-			parent(x) = parent(parent(x));
-			x = parent(x);
+	const HeuristicWeights start = HeuristicWeights::load(path).value_or(HeuristicWeights{});
+	auto tuned = tuning::spsa(start, settings, [&](int iteration, const HeuristicWeights& current, double score) {
+		if ((iteration + 1) % 10 == 0) {
+			std::cout << "Iteration " << iteration + 1 << ", last match " << score << ':';
+			for (auto& [name, field] : HeuristicWeights::fields) std::cout << ' ' << current.*field;
+			std::cout << '\n';
+			current.save(path);
 		}
-		return x;
-	};
+	});
+	if (!tuned.save(path)) {
+		std::cerr << "Could not write " << path << '\n';
+		return 1;
+	}
 
-	auto merge = [&sets,&find](size_t a, size_t b) {
-		a = find(a);
-		b = find(b);
-		if (a == b) return;
-		sets[b].parent = a;
-		sets[a].num_owned += sets[b].num_owned;
-		sets[a].threatened |= sets[b].threatened;
-		sets[a].num_threatened_by += sets[b].num_threatened_by;
-	};
+	tournament::Settings check;
+	check.strategies = { tuning::strategyFor(settings.evaluator, tuned, "tuned"), tuning::strategyFor(settings.evaluator, start, "start") };
+	check.board_sizes = { settings.board_size };
+	check.games_per_pairing = 1000;
+	check.threads = settings.threads;
+	check.seed = settings.seed;
+	auto results = tournament::run(check, [](auto&) {});
+	auto elo = results.elo(0);
+	std::cout << "Tuned vs start: " << results.pairings[0].wins << '-' << results.pairings[0].losses << '-' << results.pairings[0].draws
+		<< ", Elo " << std::lround(elo.elo) << " [" << std::lround(elo.low) << ", " << std::lround(elo.high) << "]\n";
+	return 0;
+}
 
-	int count = 0;
-	board.iterTiles([&](TriCoord c) {
-		if (board[c].num == board.allowedPieces(c)) {
-			size_t s = coord_to_set(c);
-			if (board[c].player == player) sets[s].num_owned = board[c].num;
-			else {
-				sets[s].threatened = true;
+//Solves a board size completely and writes the tablebase
+int generateTablebase(int argc, char** argv) {
+	if (argc < 4) {
+		std::cerr << "usage: " << argv[0] << " tablebase <board size> <file> [max positions]\n";
+		return 1;
+	}
+	const int size = std::stoi(argv[2]);
+	const std::string path = argv[3];
+	const std::size_t max_positions = argc > 4 ? std::stoull(argv[4]) : 100'000'000;
+
+	auto positions = Tablebase::generate(size, path, max_positions, [](std::size_t pieces, std::size_t count) {
+		if (count) std::cout << "Positions with " << pieces << " pieces: " << count << '\n';
+	});
+	if (!positions) {
+		std::cerr << "Board size " << size << " has too many positions to solve\n";
+		return 1;
+	}
+	auto table = Tablebase::open(path);
+	if (!table) {
+		std::cerr << "Could not write " << path << '\n';
+		return 1;
+	}
+	auto start = *table->probe(Board(size), 0);
+	std::cout << *positions << " positions, the first player " << (start.result == Tablebase::Result::Win ? "wins" : start.result == Tablebase::Result::Loss ? "loses" : "draws")
+		<< " after " << start.distance << " moves with perfect play\n";
+	return 0;
+}
+
+//Searches the openings of a board size and writes the book
+int buildBook(int argc, char** argv) {
+	if (argc < 4) {
+		std::cerr << "usage: " << argv[0] << " book <board size> <file> [plies] [search depth] [threads]\n";
+		return 1;
+	}
+	const int size = std::stoi(argv[2]);
+	const std::string path = argv[3];
+	OpeningBook::Settings settings;
+	if (argc > 4) settings.plies = std::stoi(argv[4]);
+	if (argc > 5) settings.depth = std::stoi(argv[5]);
+	settings.threads = argc > 6 ? std::stoi(argv[6]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+	const bool written = OpeningBook::build(size, path, settings, [](int ply, std::size_t searched) {
+		std::cout << "Ply " << ply + 1 << ": searched " << searched << " positions\n";
+	});
+	if (!written || !OpeningBook::open(path)) {
+		std::cerr << "Could not write " << path << '\n';
+		return 1;
+	}
+	return 0;
+}
+
+std::vector<std::string> split(const std::string& list) {
+	std::vector<std::string> ret;
+	for (auto part : std::views::split(list, ',')) {
+		ret.emplace_back(part.begin(), part.end());
+	}
+	return ret;
+}
+
+//Proves who wins the position reached by the given moves, players taking turns starting with player 0
+int solvePosition(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " solve <board size> [x,y,r moves from the empty board...] [--nodes n] [--table-mb n]\n";
+		return 1;
+	}
+	Board b(std::stoi(argv[2]));
+	int player = 0;
+	long long nodes = 1'000'000;
+	std::size_t table_mb = 256;
+	for (int i = 3; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--nodes" && i + 1 < argc) nodes = std::stoll(argv[++i]);
+		else if (arg == "--table-mb" && i + 1 < argc) table_mb = std::stoull(argv[++i]);
+		else {
+			auto parts = split(arg);
+			if (parts.size() != 3) {
+				std::cerr << "Moves are written as x,y,r\n";
+				return 1;
+			}
+			const TriCoord c{ std::stoi(parts[0]), std::stoi(parts[1]), parts[2] == "1" };
+			if (!b.inBounds(c) || (b[c].num != 0 && b[c].player != player)) {
+				std::cerr << "Illegal move " << arg << '\n';
+				return 1;
 			}
+			if (playMove(b, c, player) != MoveEnd::Continues) {
+				std::cerr << "The game is over after " << arg << '\n';
+				return 1;
+			}
+			player = 1 - player;
+		}
+	}
 
-			for (auto& neighbor : c.neighbors()) {
-				if (not board.inBounds(neighbor)) continue;
+	search::ProofSolver solver(table_mb << 20);
+	auto solution = solver.solve(b, player, nodes);
+	constexpr const char* results[] = { "win", "loss", "draw", "unknown" };
+	std::cout << results[static_cast<int>(solution.result)] << " for player " << player << " after " << solution.nodes << " nodes\n";
+	if (!solution.principal_variation.empty()) {
+		std::cout << "principal variation:";
+		for (auto c : solution.principal_variation) std::cout << ' ' << c.x << ',' << c.y << ',' << c.R;
+		std::cout << '\n';
+	}
+	return 0;
+}
+
+//Plays many games at once in one process and reports throughput and move latencies
+int runPool(int argc, char** argv) {
+	if (argc < 4) {
+		std::cerr << "usage: " << argv[0] << " pool <strategy> <strategy> [games] [concurrent games] [threads] [board size]\n";
+		return 1;
+	}
+	auto first = simulation::strategyByName(argv[2]);
+	auto second = simulation::strategyByName(argv[3]);
+	if (!first || !second) {
+		std::cerr << "The pool plays random, greedy, biggest, heuristic or chains\n";
+		return 1;
+	}
+	simulation::Settings settings;
+	if (argc > 4) settings.games = std::stoll(argv[4]);
+	if (argc > 5) settings.concurrent = std::stoi(argv[5]);
+	settings.threads = argc > 6 ? std::stoi(argv[6]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	if (argc > 7) settings.board_size = std::stoi(argv[7]);
+	settings.seed = std::random_device{}();
+
+	auto report = simulation::run({ *first, *second }, settings);
+	auto micros = [&](double fraction) { return report.latency.percentile(fraction).count() / 1000.0; };
+	std::cout << argv[2] << ' ' << report.wins[0] << " wins, " << argv[3] << ' ' << report.wins[1] << " wins, " << report.draws << " draws\n"
+		<< report.games() << " games, " << report.turns << " moves in " << report.seconds << "s: "
+		<< report.games() / report.seconds << " games/s, " << report.turns / report.seconds << " moves/s\n"
+		<< "Move latency in us: p50 " << micros(0.5) << ", p90 " << micros(0.9) << ", p99 " << micros(0.99) << ", p99.9 " << micros(0.999)
+		<< ", max " << report.latency.max().count() / 1000.0 << '\n'
+		<< report.bytes_per_game << " bytes per game in progress\n";
+	return 0;
+}
 
-				auto neighbor_set = coord_to_set(neighbor);
-				if (neighbor_set < s) {
-					merge(neighbor_set, s);
-				}
+//Summarizes a file of game records, --check also replays every game to see that it ends the way it says
+//and that seeking to each of its moves gives the same board as playing up to it
+int scanRecords(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " records <file> [--check]\n";
+		return 1;
+	}
+	const bool check = argc > 3 && std::string(argv[3]) == "--check";
+	auto file = MappedFile::openReadOnly(argv[2]);
+	auto reader = file ? records::Reader::open({ file->data(), file->size() }) : std::nullopt;
+	if (!reader) {
+		std::cerr << "Could not read " << argv[2] << '\n';
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	long long games = 0, moves = 0, draws = 0, mismatches = 0, seek_mismatches = 0;
+	std::map<std::string, long long, std::less<>> wins;
+	while (auto r = reader->next()) {
+		++games;
+		moves += static_cast<long long>(r->move_count);
+		if (!r->winner) ++draws;
+		else if (auto w = wins.find(r->strategy(*r->winner)); w != wins.end()) w->second++;
+		else wins.emplace(r->strategy(*r->winner), 1);
+
+		if (check) {
+			Board b(r->board_size);
+			int player = 0;
+			std::optional<int> winner;
+			r->forEachMove([&](TriCoord c) {
+				if (playMove(b, c, player) == MoveEnd::Won) winner = player;
+				player = nextActivePlayer(b, player, r->players);
+			});
+			if (winner != r->winner) ++mismatches;
+
+			records::Replay replay(*r);
+			Board straight(r->board_size), sought(r->board_size);
+			bool same = replay.winner() == r->winner && replay.moveCount() == r->move_count;
+			for (std::size_t n = 0; n <= replay.moveCount() && same; ++n) {
+				replay.seek(n, sought);
+				same = std::ranges::equal(straight.tiles(), sought.tiles(), [](TileState a, TileState b) {return a.player == b.player && a.num == b.num; });
+				if (n < replay.moveCount()) playMove(straight, replay.move(n), replay.mover(n));
 			}
+			if (!same) ++seek_mismatches;
 		}
-		else if (board[c].num > 0) {
-			bool any_exploding_neighbor = false;
-			bool is_player = board[c].player == player;
-			for (auto& neighbor : c.neighbors()) {
-				if (not board.inBounds(neighbor) || board[neighbor].num != board.allowedPieces(neighbor)) continue;
-				any_exploding_neighbor = true;
-				if (!is_player) {
-					size_t neighbor_set = find(coord_to_set(neighbor));
-					sets[neighbor_set].num_threatened_by += board[c].num;
-				}
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << games << " games, " << moves << " moves, " << file->size() << " bytes, scanned in " << seconds << "s (" << games / seconds << " games/s)\n";
+	for (auto& [name, count] : wins) std::cout << name << ": " << count << " wins\n";
+	std::cout << draws << " draws\n";
+	if (reader->failed()) std::cerr << "The file ends in a broken record\n";
+	if (check) std::cout << mismatches << " games didn't replay to their recorded result, " << seek_mismatches << " didn't seek to the same boards\n";
+	return reader->failed() || mismatches || seek_mismatches ? 1 : 0;
+}
+
+//Collects the unique positions of record files into a corpus, then reads it back once to time iterating it
+int buildCorpus(int argc, char** argv) {
+	corpus::Settings settings;
+	std::vector<std::string> inputs;
+	for (int i = 3; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--memory-mb" && i + 1 < argc) settings.memory_bytes = std::stoull(argv[++i]) << 20;
+		else if (arg == "--size" && i + 1 < argc) settings.board_size = std::stoi(argv[++i]);
+		else inputs.push_back(arg);
+	}
+	if (inputs.empty()) {
+		std::cerr << "usage: " << argv[0] << " corpus <corpus file> <record files...> [--memory-mb n] [--size n]\n";
+		return 1;
+	}
+
+	std::optional<corpus::Report> report;
+	{
+		corpus::Builder builder(argv[2], settings);
+		for (auto& input : inputs) {
+			auto file = MappedFile::openReadOnly(input);
+			auto reader = file ? records::Reader::open({ file->data(), file->size() }) : std::nullopt;
+			if (!reader) {
+				std::cerr << "Could not read " << input << '\n';
+				return 1;
 			}
-			if(!any_exploding_neighbor && is_player) count += board[c].num; //Count the piece as a single added thing but not part of any chain
+			while (auto r = reader->next()) builder.add(*r);
+			if (reader->failed()) std::cerr << input << " ends in a broken record\n";
 		}
-		return true;
-	});
+		report = builder.finish();
+	}
+	auto positions = report ? corpus::PositionCorpus::open(argv[2]) : std::nullopt;
+	if (!positions) {
+		std::cerr << "Could not write " << argv[2] << '\n';
+		return 1;
+	}
+	std::cout << report->games << " games (" << report->skipped_games << " on other board sizes skipped), " << report->positions << " positions, "
+		<< report->unique << " unique, " << report->runs << " sorted runs, built in " << report->seconds << "s\n";
 
-	auto all_sets = std::views::iota(size_t{ 0 }, sets.size())
-		| std::views::filter([&](size_t s) {return sets[s].parent == s; });
+	auto start = std::chrono::steady_clock::now();
+	std::uint64_t seen = 0, wins = 0;
+	for (std::size_t i = 0; i < positions->size(); ++i) {
+		auto p = (*positions)[i];
+		seen += p.seen;
+		wins += p.wins;
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << positions->size() << " positions of " << positions->stride() << " bytes read in " << seconds << "s, the player to move won "
+		<< 100.0 * wins / std::max<std::uint64_t>(seen, 1) << "% of the time\n";
+	return 0;
+}
 
-	for (size_t s : all_sets) {
-		auto& set = sets[s];
-		count += set.threatened ? set.num_owned * -7 : set.num_owned * 3 + set.num_threatened_by * 2;
+//Speaks the text protocol of engine.hpp over stdin and stdout
+int runEngine(int argc, char** argv) {
+	search::ParallelSearch::Settings settings;
+	settings.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	settings.table_bytes = std::size_t(16) << 20;
+	for (int i = 2; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) settings.threads = std::stoi(argv[++i]);
+		else if (arg == "--table-mb" && i + 1 < argc) settings.table_bytes = std::stoull(argv[++i]) << 20;
+		else if (arg == "--table-file" && i + 1 < argc) settings.table_file = argv[++i];
+		else {
+			std::cerr << "usage: " << argv[0] << " engine [--threads n] [--table-mb n] [--table-file file]\n";
+			return 1;
+		}
 	}
+	return engine::run(std::cin, std::cout, settings);
+}
 
-	return count;
-});
+void printUsage(const char* name) {
+	std::cerr << "usage: " << name << " [options]\n"
+		<< "  --strategies a,b,...   strategies to play: random, greedy, biggest, heuristic, chains, maxn[:<depth>],\n"
+		<< "                         smp[:<threads>:<ms>[:<file>]], heuristic:<file>, chains:<file>,\n"
+		<< "                         ntuple:<file>, tablebase:<file>, book:<file> (default chains,greedy)\n"
+		<< "  --sizes 3,4,...        board sizes to play on (default 3)\n"
+		<< "  --games n              games per pairing and board size (default 1000)\n"
+		<< "  --threads n            worker threads (default: all cores)\n"
+		<< "  --schedule s           round-robin or gauntlet, gauntlet plays the first strategy against the others\n"
+		<< "  --seed n               seed for the AI players' random choices, printed with the results\n"
+		<< "  --replay n             only play game n of the tournament again, needs the same options and seed\n"
+		<< "  --max-steps n          steps after which a game is counted as a draw (default 100000)\n"
+		<< "  --processes n          play in n worker processes instead of threads, crashed workers get restarted\n"
+		<< "  --games-per-process n  replace worker processes after n games (default: never)\n"
+		<< "  --crash-rate p         chance of a worker process aborting during a game, to test the recovery\n"
+		<< "  --record file          write every game to file as it finishes, not with --processes\n"
+		<< "   or: " << name << " train-ntuple <weights file> [games] [threads] [board size]\n"
+		<< "   or: " << name << " tune <heuristic|chains> <weights file> [iterations] [games per iteration] [threads] [board size]\n"
+		<< "   or: " << name << " tablebase <board size> <file> [max positions]\n"
+		<< "   or: " << name << " book <board size> <file> [plies] [search depth] [threads]\n"
+		<< "   or: " << name << " solve <board size> [x,y,r moves from the empty board...] [--nodes n] [--table-mb n]\n"
+		<< "   or: " << name << " pool <strategy> <strategy> [games] [concurrent games] [threads] [board size]\n"
+		<< "   or: " << name << " records <file> [--check]\n"
+		<< "   or: " << name << " corpus <corpus file> <record files...> [--memory-mb n] [--size n]\n"
+		<< "   or: " << name << " engine [--threads n] [--table-mb n] [--table-file file]\n";
+}
 
-int main() {
-	std::default_random_engine random_initializer(std::random_device{}());
+void printResults(const tournament::Settings& settings, const tournament::Results& results) {
+	std::cout << '\n';
+	for (auto& p : results.pairings) {
+		auto elo = tournament::estimateElo(p.wins, p.losses, p.draws);
+		std::cout << settings.strategies[p.first].name << " vs " << settings.strategies[p.second].name << ": "
+			<< p.wins << " wins, " << p.losses << " losses, " << p.draws << " draws, Elo " << std::lround(elo.elo)
+			<< " [" << std::lround(elo.low) << ", " << std::lround(elo.high) << "]\n";
+	}
+	std::cout << '\n';
+	for (int s = 0; s < static_cast<int>(settings.strategies.size()); ++s) {
+		auto elo = results.elo(s);
+		std::cout << settings.strategies[s].name << ": Elo against the field " << std::lround(elo.elo) << " [" << std::lround(elo.low) << ", " << std::lround(elo.high) << "]\n";
+	}
+	std::cout << "Total game steps: " << results.total_steps << " in " << results.seconds << "s\n";
+	std::cout << "Seed: " << settings.seed << "\n";
+}
 
-	BoardWithPlayers game(3);
-	game.addPlayer(std::make_unique<AI::AIPlayer>(AI::firstSuccess(
-		AI::filtered(heuristic, AI::randomAI(random_initializer)),
-		AI::randomAI(random_initializer)
-	)));
-	game.addPlayer(std::make_unique<AI::AIPlayer>(AI::firstSuccess(
-		AI::filtered(AI::maxGain, AI::randomAI(random_initializer)),
-		AI::randomAI(random_initializer)
-	)));
+int main(int argc, char** argv) {
+	if (argc > 1 && std::string(argv[1]) == "train-ntuple") {
+		return trainNTuple(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "tune") {
+		return tuneWeights(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "tablebase") {
+		return generateTablebase(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "book") {
+		return buildBook(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "solve") {
+		return solvePosition(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "pool") {
+		return runPool(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "records") {
+		return scanRecords(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "corpus") {
+		return buildCorpus(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "engine") {
+		return runEngine(argc, argv);
+	}
 
-	std::vector<int> wins(game.getPlayerCount());
-	int total_game_steps = 0;
-	constexpr int total_games = 1000;
-	for (int i = 0; i < total_games; ++i) {
-		game.reset();
-		while (true) {
-			game.update();
-			total_game_steps++;
-			if (auto win = game.getWinner(); win) {
-				wins[*win]++;
-				break;
+	tournament::Settings settings;
+	settings.games_per_pairing = 1000;
+	settings.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	settings.seed = std::random_device{}();
+	std::vector<std::string> strategy_names = { "chains", "greedy" };
+	//turned into distributed::Settings only where worker processes exist
+	struct ProcessOptions {
+		int processes = 1;
+		int games_per_process = 0;
+		double crash_rate = 0;
+	};
+	std::optional<ProcessOptions> process_options;
+	std::optional<long long> replay;
+	std::string record_path;
+	auto processOptions = [&]() -> ProcessOptions& {
+		if (!process_options) process_options.emplace();
+		return *process_options;
+	};
+
+	try {
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			if (i + 1 >= argc) {
+				printUsage(argv[0]);
+				return 1;
+			}
+			const std::string value = argv[++i];
+			if (arg == "--strategies") strategy_names = split(value);
+			else if (arg == "--sizes") {
+				settings.board_sizes.clear();
+				for (auto& s : split(value)) settings.board_sizes.push_back(std::stoi(s));
+			}
+			else if (arg == "--games") settings.games_per_pairing = std::stoi(value);
+			else if (arg == "--threads") settings.threads = std::max(1, std::stoi(value));
+			else if (arg == "--seed") settings.seed = std::stoull(value);
+			else if (arg == "--max-steps") settings.max_steps = std::stoi(value);
+			else if (arg == "--replay") replay = std::stoll(value);
+			else if (arg == "--record") record_path = value;
+			else if (arg == "--processes") processOptions().processes = std::max(1, std::stoi(value));
+			else if (arg == "--games-per-process") processOptions().games_per_process = std::max(0, std::stoi(value));
+			else if (arg == "--crash-rate") processOptions().crash_rate = std::stod(value);
+			else if (arg == "--schedule" && (value == "round-robin" || value == "gauntlet")) {
+				settings.schedule = value == "gauntlet" ? tournament::Schedule::Gauntlet : tournament::Schedule::RoundRobin;
+			}
+			else {
+				printUsage(argv[0]);
+				return 1;
 			}
 		}
-		if (i % 100 == 99) {
-			std::cout << i + 1 << ": ";
-			for(auto w : wins) {
-				std::cout << w << ' ';
+	}
+	catch (const std::logic_error&) { //std::stoi and friends
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	for (auto& name : strategy_names) {
+		auto strategy = tournament::strategyByName(name);
+		if (!strategy) {
+			std::cerr << "Unknown strategy " << name << '\n';
+			return 1;
+		}
+		settings.strategies.push_back(std::move(*strategy));
+	}
+	if (settings.strategies.size() < 2 || settings.board_sizes.empty()) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	if (replay) {
+		const auto plan = tournament::makePlan(settings);
+		if (*replay < 0 || *replay >= plan.total_games) {
+			std::cerr << "The tournament only has " << plan.total_games << " games\n";
+			return 1;
+		}
+		const auto& pairing = plan.pairings[(*replay % plan.games_per_size) / settings.games_per_pairing];
+		const bool swapped = *replay % 2 == 1;
+		const std::string names[2] = { settings.strategies[pairing.first].name, settings.strategies[pairing.second].name };
+		const auto outcome = tournament::playScheduledGame(settings, plan, *replay);
+		std::cout << "Game " << *replay << " on size " << settings.board_sizes[*replay / plan.games_per_size] << ": "
+			<< names[swapped] << " vs " << names[!swapped] << ", ";
+		if (outcome.winner) std::cout << names[(*outcome.winner == 1) != swapped] << " won";
+		else std::cout << "draw";
+		std::cout << " after " << outcome.steps << " steps\n";
+		return 0;
+	}
+
+	int games_done = 0;
+	auto on_game = [&](const tournament::Results& results) {
+		if (++games_done % 100 == 0) {
+			std::cout << games_done << ": ";
+			for (auto& p : results.pairings) {
+				std::cout << p.wins << '-' << p.losses << '-' << p.draws << ' ';
 			}
 			std::cout << '\n';
 		}
+	};
+
+	if (process_options && !record_path.empty()) {
+		std::cerr << "--record only works without --processes\n";
+		return 1;
+	}
+	if (process_options) {
+#ifdef EXPLODINGTILES_HAS_PROCESSES
+		const distributed::Settings process_settings{
+			.processes = process_options->processes,
+			.crash_rate = process_options->crash_rate,
+			.games_per_process = process_options->games_per_process,
+		};
+		printResults(settings, distributed::run(settings, process_settings, on_game));
+#else
+		std::cerr << "Worker processes aren't supported on this platform\n";
+		return 1;
+#endif
+	}
+	else if (!record_path.empty()) {
+		std::ofstream out(record_path, std::ios::binary);
+		records::Writer writer(out);
+		auto results = tournament::run(settings, on_game, &writer);
+		writer.flush();
+		if (!out) {
+			std::cerr << "Could not write " << record_path << '\n';
+			return 1;
+		}
+		printResults(settings, results);
+	}
+	else {
+		printResults(settings, tournament::run(settings, on_game));
 	}
-	std::cout << "Total game steps: " << total_game_steps << '\n';
-}
\ No newline at end of file
+}
@@ -5,6 +5,7 @@
 #include <memory>
 #include <span>
 #include <cmath>
+#include <thread>
 #include <SFML/Window.hpp>
 #include <SFML/Graphics.hpp>
 
@@ -14,6 +15,8 @@
 #include "player.hpp"
 #include "shapes.hpp"
 #include "game.hpp"
+#include "replay.hpp"
+#include "analysis.hpp"
 
 std::string_view default_color_shader = R"(
 #version 120
@@ -44,11 +47,15 @@ std::string_view board_shader = R"(
 const float edge_thickness = 0.04;
 const vec3 edge_color = vec3(1);
 const vec3 highlight_color = vec3(1,0,1);
+const vec3 bad_move_color = vec3(0.8,0.1,0.1);
+const vec3 good_move_color = vec3(0.1,0.8,0.2);
 
 uniform sampler2D board;
 uniform int hex_size;
 uniform ivec3 selected;
 uniform float pulse_progress;
+uniform sampler2D analysis;
+uniform bool show_analysis;
 
 float min3(vec3 v) {
 	return min(min(v.x,v.y),v.z);
@@ -75,6 +82,14 @@ vec4 tile_color(ivec3 coords, ivec2 tile_data) {
 	return vec4(0);
 }
 
+//heat_data is how good the move is and whether it has a score yet
+vec4 heat_color(ivec2 heat_data) {
+	if(show_analysis && heat_data.y != 0) {
+		return vec4(mix(bad_move_color,good_move_color,float(heat_data.x)/255.),0.45);
+	}
+	return vec4(0);
+}
+
 void main()
 {
 	vec3 min_bound = vec3(1);
@@ -98,11 +113,14 @@ void main()
 		}
 		ivec4 tile = ivec4(texelFetch(board,current.xy,0) * 255.);
 		//grab the correct tile out
+		ivec4 heat = ivec4(texelFetch(analysis,current.xy,0) * 255.);
 		ivec2 t = tile.rg;
+		ivec2 h = heat.rg;
 		if(current.x + current.y + current.z == (hex_size*3 - 1)) {
 			t = tile.ba;
+			h = heat.ba;
 		}
-		vec4 color = tile_color(current,t);
+		vec4 color = blend(heat_color(h),tile_color(current,t));
 		gl_FragColor = blend(color,gl_FragColor);
 	} else if(all(greaterThan(coordinates,min_bound-bound_edge)) && all(lessThan(coordinates,max_bound+bound_edge))) {
 		//Outer edge
@@ -120,11 +138,14 @@ class VisualBoard : public sf::Transformable, public sf::Drawable {
 	sf::Vector2f inner[3]; //for coordinate calculations
 	sf::Texture board_rep;
 	sf::Image board_rep_img;
+	sf::Texture heat_rep; //packed like board_rep
+	sf::Image heat_rep_img;
+	bool show_heat = false;
 	sf::Clock start_time;
 public:
 	inline static sf::Shader* shader = nullptr;
 	
-	sf::Vector3i selected;
+	Vec3i selected{};
 	int board_size;
 
 	VisualBoard(float radius, int board_size) : board_size(board_size) {
@@ -145,6 +166,12 @@ public:
 		board_rep.setRepeated(false);
 		board_rep.setSrgb(false);
 		board_rep.loadFromImage(board_rep_img);
+
+		heat_rep_img.create(board_size * 2, board_size * 2, sf::Color::Transparent);
+		heat_rep.setSmooth(false);
+		heat_rep.setRepeated(false);
+		heat_rep.setSrgb(false);
+		heat_rep.loadFromImage(heat_rep_img);
 	}
 
 	//call whenever the board changes
@@ -166,6 +193,30 @@ public:
 		board_rep.update(board_rep_img);
 	}
 
+	//heat from 0 for the worst move to 1 for the best, drawn under the tiles until hideHeat()
+	void updateHeat(std::span<const std::pair<TriCoord, float>> heat) {
+		heat_rep_img.create(board_size * 2, board_size * 2, sf::Color::Transparent);
+		for (auto [c, h] : heat) {
+			auto current = heat_rep_img.getPixel(c.x, c.y);
+			const auto value = static_cast<sf::Uint8>(std::clamp(h, 0.f, 1.f) * 255);
+			if (c.R) {
+				current.r = value;
+				current.g = 1;
+			}
+			else {
+				current.b = value;
+				current.a = 1;
+			}
+			heat_rep_img.setPixel(c.x, c.y, current);
+		}
+		heat_rep.update(heat_rep_img);
+		show_heat = true;
+	}
+
+	void hideHeat() {
+		show_heat = false;
+	}
+
 	float getRadius() const {
 		return (inner[1].y - inner[0].y) / 3;
 	}
@@ -186,18 +237,20 @@ public:
 		//ensure out of bounds coordinate when a coordinate < 0, converting to int != floor. Subtract one if a coordinate was below 0
 		bary -= sf::Vector3i(v1 < 0, v2 < 0, v1 + v2 > 1);
 
-		return TriCoord(bary, board_size);
+		return TriCoord({ bary.x, bary.y, bary.z }, board_size);
 	}
 
-	sf::Vector2f baryToScreen(sf::Vector3f tri) const {
+	sf::Vector2f baryToScreen(Vec3f tri) const {
 		return getTransform().transformPoint(tri.x * inner[0] + tri.y * inner[1] + tri.z * inner[2]);
 	}
 
 	void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
 		shader->setUniform("hex_size", board_size);
-		shader->setUniform("selected", selected);
+		shader->setUniform("selected", sf::Glsl::Ivec3(selected.x, selected.y, selected.z));
 		float progress = inverseLerp(-1.f,1.f,std::sin(4*start_time.getElapsedTime().asSeconds()));
 		shader->setUniform("pulse_progress", progress);
+		shader->setUniform("analysis", heat_rep);
+		shader->setUniform("show_analysis", show_heat);
 		target.draw(outer, 3, sf::PrimitiveType::Triangles, { sf::BlendAlpha, states.transform * getTransform(), &board_rep, shader });
 	}
 };
@@ -313,7 +366,11 @@ namespace state_transitions {
 	struct ReturnToMain {};
 	struct OpenPlayerSelect {};
 	struct OpenTutorial {};
-	using StateChangeEvent = std::variant<std::monostate, OpenPlayerSelect, StartGame, ReturnToMain, OpenTutorial>;
+	struct OpenReplay {
+		StartGame game;
+		std::vector<TriCoord> moves;
+	};
+	using StateChangeEvent = std::variant<std::monostate, OpenPlayerSelect, StartGame, ReturnToMain, OpenTutorial, OpenReplay>;
 }
 
 class State : public sf::Drawable {
@@ -326,10 +383,26 @@ public:
 class GameState : public State {
 	BoardWithPlayers board;
 	VisualBoard visual_board;
+	state_transitions::StartGame game_info;
+	std::vector<TriCoord> moves; //for the replay, the first played of them lead to the position, the rest can be redone
+
+	struct Turn {
+		GameSnapshot snapshot;
+		std::size_t played;
+	};
+	UndoHistory<Turn> history; //a snapshot after every turn
+	std::size_t played = 0;
 
 	sf::Clock explode_timer;
 
 	sf::VertexArray reset_arrow;
+	sf::CircleShape replay_button;
+	sf::CircleShape undo_button, redo_button;
+	sf::CircleShape analysis_button;
+
+	//scores every move of the player to move while it's turned on
+	std::optional<analysis::MoveAnalyzer> analyzer;
+	bool show_analysis = false;
 
 	sf::Vector2f show_current_player;
 	std::vector<sf::CircleShape> players;
@@ -343,9 +416,60 @@ class GameState : public State {
 		players.push_back(playerShape(polygon_n, color, visual_board.getTriRadius()));
 	}
 
+	bool humanToMove() const {
+		return game_info.players[board.getCurrentPlayerNum()].playerBehavior == PlayerType::Mouse;
+	}
+
+	bool anyHuman() const {
+		return std::ranges::any_of(game_info.players, [](auto& p) {return p.playerBehavior == PlayerType::Mouse; });
+	}
+
+	//Goes back to the last position where it was a human's turn, or just one turn when only AIs play.
+	//A turn that's still exploding or won the game is taken back to where it started.
+	void undo() {
+		if (played == history.current().played) {
+			if (!history.canUndo()) return;
+			history.undo();
+		}
+		board.restore(history.current().snapshot);
+		while (anyHuman() && !humanToMove() && history.canUndo()) board.restore(history.undo().snapshot);
+		played = history.current().played;
+		visual_board.update(board.getBoard());
+		refreshAnalysis();
+	}
+
+	void redo() {
+		if (!history.canRedo() || played != history.current().played) return;
+		board.restore(history.redo().snapshot);
+		while (anyHuman() && !humanToMove() && history.canRedo()) board.restore(history.redo().snapshot);
+		played = history.current().played;
+		visual_board.update(board.getBoard());
+		refreshAnalysis();
+	}
+
+	//Starts on the position once a turn is over, stops while the explosions run and after a win.
+	//The analyzer never makes the game wait, its scores show up over the next frames.
+	void refreshAnalysis() {
+		if (!show_analysis) return;
+		if (board.getWinner() || board.getBoard().needsUpdate()) analyzer->cancel();
+		else analyzer->analyze(board.getBoard(), board.getCurrentPlayerNum(), static_cast<int>(board.getPlayerCount()));
+	}
+
+	void toggleAnalysis() {
+		show_analysis = !show_analysis;
+		if (show_analysis) {
+			if (!analyzer) analyzer.emplace(analysis::MoveAnalyzer::Settings{ static_cast<int>(std::max(std::thread::hardware_concurrency(), 2u) - 1) });
+			refreshAnalysis();
+		}
+		else {
+			analyzer->cancel();
+			visual_board.hideHeat();
+		}
+	}
+
 public:
 	GameState(sf::Vector2f center, float radius, const state_transitions::StartGame& game_info) 
-		: board(game_info.board_size), visual_board(radius * .9f, game_info.board_size), bar({ center - sf::Vector2f(radius, radius), sf::Vector2f(2 * radius, radius * 0.1f) }), exit(sf::Color::Red,40) {
+		: board(game_info.board_size), visual_board(radius * .9f, game_info.board_size), game_info(game_info), replay_button(15, 3), undo_button(12, 3), redo_button(12, 3), analysis_button(10), bar({ center - sf::Vector2f(radius, radius), sf::Vector2f(2 * radius, radius * 0.1f) }), exit(sf::Color::Red,40) {
 		
 		exit.setPosition(60, 60);
 		exit.setRotation(45);
@@ -367,9 +491,35 @@ public:
 
 		reset_arrow = circArrow(center - extra_offset, sf::Color::White, 15, 24, 5);
 
+		replay_button.setFillColor(sf::Color::White);
+		replay_button.setOrigin(replay_button.getRadius(), replay_button.getRadius());
+		replay_button.setRotation(90);
+		replay_button.setPosition(center + sf::Vector2f(extra_offset.x, -extra_offset.y));
+
+		//across from the current player
+		const sf::Vector2f history_buttons = center + sf::Vector2f(center.x - show_current_player.x, show_current_player.y - center.y);
+		for (auto* button : { &undo_button, &redo_button }) {
+			button->setOrigin(button->getRadius(), button->getRadius());
+		}
+		undo_button.setRotation(-90);
+		undo_button.setPosition(history_buttons - sf::Vector2f(20, 0));
+		redo_button.setRotation(90);
+		redo_button.setPosition(history_buttons + sf::Vector2f(20, 0));
+
+		analysis_button.setOrigin(analysis_button.getRadius(), analysis_button.getRadius());
+		analysis_button.setOutlineColor(sf::Color::White);
+		analysis_button.setOutlineThickness(2);
+		analysis_button.setPosition(history_buttons + sf::Vector2f(0, 45));
+
 		for (auto& [num, color, behavior] : game_info.players) {
-			addPlayer(num, color, toPlayer(behavior));
+			addPlayer(num, color, toPlayer(behavior, static_cast<int>(game_info.players.size())));
 		}
+		board.setMoveListener([this](TriCoord c, int) {
+			moves.resize(played);
+			moves.push_back(c);
+			++played;
+		});
+		history.push({ board.snapshot(), 0 });
 	}
 
 	void mouseMove(sf::Vector2f mouse) override {
@@ -386,11 +536,28 @@ public:
 		if (reset_arrow.getBounds().contains(mouse)) {
 			board.reset();
 			bar.reset();
+			moves.clear();
+			played = 0;
+			history.clear();
+			history.push({ board.snapshot(), 0 });
 			visual_board.update(board.getBoard());
+			refreshAnalysis();
+		}
+		else if (undo_button.getGlobalBounds().contains(mouse)) {
+			undo();
+		}
+		else if (redo_button.getGlobalBounds().contains(mouse)) {
+			redo();
+		}
+		else if (analysis_button.getGlobalBounds().contains(mouse)) {
+			toggleAnalysis();
 		}
 		else if (exit.getBounds().contains(mouse)) {
 			return state_transitions::ReturnToMain{};
 		}
+		else if (board.getWinner() && replay_button.getGlobalBounds().contains(mouse)) {
+			return state_transitions::OpenReplay{ game_info, std::vector(moves.begin(), moves.begin() + played) };
+		}
 		else {
 			board.getCurrentPlayer().onInput(input_events::MouseClick{ visual_board.mouseToBoard(mouse) });
 		}
@@ -401,9 +568,18 @@ public:
 		if (not board.getWinner() && (not board.getBoard().needsUpdate() || explode_timer.getElapsedTime().asSeconds() > explosion_length)) {
 			if (board.update()) {
 				visual_board.update(board.getBoard());
+				if (not board.getBoard().needsUpdate() && not board.getWinner()) history.push({ board.snapshot(), played });
+				refreshAnalysis();
 			}
 			explode_timer.restart();
 		}
+		if (show_analysis) {
+			if (auto scores = analyzer->poll()) visual_board.updateHeat(analysis::heatMap(*scores));
+		}
+		const bool can_undo = history.canUndo() || played != history.current().played;
+		undo_button.setFillColor(can_undo ? sf::Color::White : sf::Color(255, 255, 255, 60));
+		redo_button.setFillColor(history.canRedo() && played == history.current().played ? sf::Color::White : sf::Color(255, 255, 255, 60));
+		analysis_button.setFillColor(show_analysis ? sf::Color::White : sf::Color::Transparent);
 		visual_board.selected = board.getCurrentPlayer().selected().bary(board.getBoard().size());
 		bar.update(board.getBoard());
 	}
@@ -424,6 +600,8 @@ public:
 			current.setPosition(visual_board.getPosition());
 			current.setOutlineThickness(current.getRadius() / 20);
 			target.draw(current, states);
+
+			target.draw(replay_button, states);
 		}
 		else {
 			const float explosion_progress = explode_timer.getElapsedTime().asSeconds() / explosion_length;
@@ -436,6 +614,9 @@ public:
 		}
 
 		target.draw(reset_arrow, states);
+		target.draw(undo_button, states);
+		target.draw(redo_button, states);
+		target.draw(analysis_button, states);
 		target.draw(bar, states);
 		target.draw(exit, states);
 	}
@@ -1156,6 +1337,174 @@ public:
 	}
 };
 
+//Plays a finished game back forward or backward, clicking the bar at the top jumps to a move and dragging along it scrubs through the game
+class ReplayState : public State {
+	records::Replay replay;
+	Board current;
+	std::size_t position = 0; //moves played on current
+	VisualBoard visual_board;
+	std::vector<sf::CircleShape> players;
+	ScoreBar bar;
+	CrossShape exit;
+
+	sf::RectangleShape scrub_bar;
+	sf::RectangleShape scrub_marker;
+	sf::CircleShape back_button, forward_button;
+
+	sf::Clock step_timer;
+	int direction = 0; //1 playing forward, -1 backward, 0 paused
+
+	static constexpr float time_between_moves = 0.6f;
+
+	//Explosions still going, the board stops at the winning one just like the game did
+	bool exploding() const {
+		return current.needsUpdate() && !current.isWon();
+	}
+
+	void showMove() {
+		if (position > 0) visual_board.selected = replay.move(position - 1).bary(replay.boardSize());
+		else visual_board.selected = {};
+		const float progress = replay.moveCount() > 0 ? static_cast<float>(position) / replay.moveCount() : 0.f;
+		scrub_marker.setPosition(scrub_bar.getPosition().x + progress * scrub_bar.getSize().x, scrub_bar.getPosition().y);
+		visual_board.update(current);
+	}
+
+	void seek(std::size_t n) {
+		replay.seek(n, current);
+		position = std::min(n, replay.moveCount());
+		showMove();
+	}
+
+	void stepForward() {
+		if (position == replay.moveCount()) {
+			direction = 0;
+			return;
+		}
+		current.incTile(replay.move(position), replay.mover(position));
+		++position;
+		showMove();
+	}
+
+	void stepBack() {
+		if (position == 0) {
+			direction = 0;
+			return;
+		}
+		seek(position - 1);
+	}
+
+	void scrubTo(sf::Vector2f mouse) {
+		const float fraction = std::clamp((mouse.x - scrub_bar.getPosition().x) / scrub_bar.getSize().x, 0.f, 1.f);
+		seek(static_cast<std::size_t>(std::lround(fraction * replay.moveCount())));
+		direction = 0;
+	}
+
+	bool onScrubBar(sf::Vector2f mouse) const {
+		auto bounds = scrub_bar.getGlobalBounds();
+		bounds.top -= bounds.height;
+		bounds.height *= 3;
+		return bounds.contains(mouse);
+	}
+
+public:
+	ReplayState(sf::Vector2f center, float radius, const state_transitions::OpenReplay& info)
+		: replay(info.game.board_size, static_cast<int>(info.game.players.size()), info.moves), current(info.game.board_size), visual_board(radius * .9f, info.game.board_size),
+		bar({ center - sf::Vector2f(radius, radius), sf::Vector2f(2 * radius, radius * 0.1f) }), exit(sf::Color::Red, 40), back_button(15, 3), forward_button(15, 3) {
+
+		exit.setPosition(60, 60);
+		exit.setRotation(45);
+
+		scrub_bar.setSize({ 2 * radius, radius * 0.04f });
+		scrub_bar.setPosition(center - sf::Vector2f(radius, radius * 0.85f));
+		scrub_bar.setFillColor(sf::Color::Black);
+		scrub_marker.setSize({ radius * 0.02f, scrub_bar.getSize().y });
+		scrub_marker.setOrigin(scrub_marker.getSize().x / 2, 0);
+		scrub_marker.setFillColor(sf::Color::Yellow);
+
+		center.y += radius * 0.2f;
+		radius *= .9f;
+
+		visual_board.setPosition(center);
+
+		sf::Transform rot = sf::Transform().rotate(-60);
+		sf::Vector2f offset = rot.transformPoint(rot.transformPoint({ 0, radius * 1.4f }));
+
+		for (auto* button : { &back_button, &forward_button }) {
+			button->setFillColor(sf::Color::Yellow);
+			button->setOrigin(button->getRadius(), button->getRadius());
+		}
+		back_button.setRotation(-90);
+		back_button.setPosition(center - offset);
+		forward_button.setRotation(90);
+		forward_button.setPosition(center + sf::Vector2f(offset.x, -offset.y));
+
+		for (auto& p : info.game.players) {
+			players.push_back(playerShape(p.shape_points, p.color, visual_board.getTriRadius()));
+			bar.addPlayer(p.color);
+		}
+		seek(0);
+	}
+
+	void mouseMove(sf::Vector2f mouse) override {
+		if (exit.getBounds().contains(mouse)) {
+			exit.setColor(sf::Color::Yellow);
+		}
+		else {
+			exit.setColor(sf::Color::Red);
+		}
+		if (sf::Mouse::isButtonPressed(sf::Mouse::Left) && onScrubBar(mouse)) {
+			scrubTo(mouse);
+		}
+	}
+
+	state_transitions::StateChangeEvent onClick(sf::Vector2f mouse) override {
+		if (exit.getBounds().contains(mouse)) {
+			return state_transitions::ReturnToMain{};
+		}
+		else if (onScrubBar(mouse)) {
+			scrubTo(mouse);
+		}
+		else if (forward_button.getGlobalBounds().contains(mouse)) {
+			direction = direction == 1 ? 0 : 1;
+			step_timer.restart();
+		}
+		else if (back_button.getGlobalBounds().contains(mouse)) {
+			direction = direction == -1 ? 0 : -1;
+			step_timer.restart();
+		}
+		return {};
+	}
+
+	void update() override {
+		const float elapsed = step_timer.getElapsedTime().asSeconds();
+		if (exploding()) {
+			if (elapsed > explosion_length) {
+				current.update_step();
+				visual_board.update(current);
+				step_timer.restart();
+			}
+		}
+		else if (direction != 0 && elapsed > time_between_moves) {
+			if (direction > 0) stepForward();
+			else stepBack();
+			step_timer.restart();
+		}
+		bar.update(current);
+	}
+
+	void draw(sf::RenderTarget& target, sf::RenderStates states) const override {
+		const float explosion_progress = exploding() ? step_timer.getElapsedTime().asSeconds() / explosion_length : 0.f;
+		draw_board(target, states, visual_board, current, players, explosion_progress);
+
+		target.draw(bar, states);
+		target.draw(scrub_bar, states);
+		target.draw(scrub_marker, states);
+		target.draw(back_button, states);
+		target.draw(forward_button, states);
+		target.draw(exit, states);
+	}
+};
+
 int main()
 {
 	sf::ContextSettings settings;
@@ -1208,6 +1557,9 @@ int main()
 						[&](state_transitions::StartGame& g) {
 							game = std::make_unique<GameState>(sf::Vector2f(400,300),250.f,g);
 						},
+						[&](state_transitions::OpenReplay& r) {
+							game = std::make_unique<ReplayState>(sf::Vector2f(400,300),250.f,r);
+						},
 						[&](state_transitions::ReturnToMain) {
 							game = std::make_unique<MainMenu>(sf::Vector2f(800,600));
 						},